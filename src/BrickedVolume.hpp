@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MiniTimer.hpp"
+#include "parallel.hpp"
+#include "read_hdf5.hpp"
+#include "util.hpp"
+#include "VoxelRegion.hpp"
+
+namespace vvv {
+
+/// Out-of-core segmentation volume that is split into cubic bricks which are read on demand from a chunked .hdf5
+/// file. Prefetched bricks are kept in a least recently used cache. Rendering uses an image assembled from the working
+/// set of bricks, e.g. those within the split planes and the view frustum. Bricks that are not resident are read
+/// straight into the image without caching them, so the volume itself may be arbitrarily large while the image of the
+/// working set's bounding region must fit into the memory budget. Resident bricks are evicted to make room for it.
+class BrickedVolume {
+  public:
+    /// Usage and I/O statistics of the brick cache.
+    struct Statistics {
+        size_t hits = 0u;               ///< requested bricks that were already resident
+        size_t misses = 0u;             ///< requested bricks that had to be read from the file
+        size_t evictions = 0u;          ///< bricks removed from the cache to stay within the budget
+        size_t bytes_read = 0u;         ///< label bytes read from the file
+        double read_seconds = 0.;       ///< time spent reading bricks
+    };
+
+    /// @param brick_size edge length of the cubic bricks in voxels, ideally a multiple of the .hdf5 chunk size
+    /// @param memory_budget maximum number of bytes that resident bricks and the assembled image may occupy together
+    /// @param thread_count number of threads for decompressing and assembling bricks, 0 for all hardware threads
+    BrickedVolume(std::string url, const size_t brick_size, const size_t memory_budget, const unsigned thread_count = 0u)
+        : m_url(std::move(url)), m_brick_size(brick_size), m_memory_budget(memory_budget), m_thread_count(thread_count) {
+        if (m_brick_size == 0u)
+            throw std::invalid_argument("brick size must be positive");
+#ifdef LIB_HIGHFIVE
+        // the file stays open for all brick reads
+        m_file = std::make_unique<HighFive::File>(m_url, HighFive::File::ReadOnly);
+        m_dataset = std::make_unique<HighFive::DataSet>(m_file->getDataSet(m_file->getObjectName(0)));
+        const std::vector<size_t> dimensions = m_dataset->getDimensions();
+        if (dimensions.size() != 3)
+            throw std::runtime_error("hdf5 volume file data set must have exactly 3 dimensions.");
+        for (int a = 0; a < 3; a++)
+            m_dim[a] = dimensions[2 - a];
+        // labels are stored in their native bit width (at most 32 bit) as in the in-core import
+        m_label_type = labelTypeForBytes(read_hdf5_label_bytes(*m_dataset));
+#else
+        throw std::runtime_error("HighFIVE / HDF5 libraries not found! Cannot load .hdf5 volume file!");
+#endif
+        m_label_bytes = static_cast<size_t>(vtkDataArray::GetDataTypeSize(m_label_type));
+        for (int a = 0; a < 3; a++)
+            m_brick_count[a] = (m_dim[a] + m_brick_size - 1u) / m_brick_size;
+    }
+
+    [[nodiscard]] const size_t (&dimensions() const)[3] { return m_dim; }
+    [[nodiscard]] int labelType() const { return m_label_type; }
+    [[nodiscard]] size_t brickCount() const { return m_brick_count[0] * m_brick_count[1] * m_brick_count[2]; }
+    [[nodiscard]] size_t residentBytes() const { return m_resident_bytes; }
+    [[nodiscard]] const Statistics &statistics() const { return m_stats; }
+
+    /// @return the voxel region covered by the brick, clamped to the volume
+    [[nodiscard]] VoxelRegion brickRegion(const size_t brick) const {
+        const size_t coord[3] = {brick % m_brick_count[0], (brick / m_brick_count[0]) % m_brick_count[1],
+                                 brick / (m_brick_count[0] * m_brick_count[1])};
+        VoxelRegion r;
+        for (int a = 0; a < 3; a++) {
+            r.min[a] = coord[a] * m_brick_size;
+            r.max[a] = std::min(r.min[a] + m_brick_size, m_dim[a]);
+        }
+        return r;
+    }
+
+    /// @return all bricks that intersect the region and for which visible(brick_region) returns true
+    template <typename Predicate>
+    [[nodiscard]] std::vector<size_t> bricksWhere(const VoxelRegion &region, Predicate &&visible) const {
+        const VoxelRegion r = region.clamped(m_dim);
+        std::vector<size_t> bricks;
+        if (r.empty())
+            return bricks;
+        for (size_t z = r.min[2] / m_brick_size; z < (r.max[2] + m_brick_size - 1u) / m_brick_size; z++) {
+            for (size_t y = r.min[1] / m_brick_size; y < (r.max[1] + m_brick_size - 1u) / m_brick_size; y++) {
+                for (size_t x = r.min[0] / m_brick_size; x < (r.max[0] + m_brick_size - 1u) / m_brick_size; x++) {
+                    const size_t brick = (z * m_brick_count[1] + y) * m_brick_count[0] + x;
+                    if (visible(brickRegion(brick)))
+                        bricks.push_back(brick);
+                }
+            }
+        }
+        return bricks;
+    }
+
+    /// @return the bounding voxel region of all bricks in the working set, an empty region if it is empty
+    [[nodiscard]] VoxelRegion boundingRegion(const std::vector<size_t> &working_set) const {
+        VoxelRegion region = VoxelRegion::full(m_dim);
+        if (working_set.empty()) {
+            region.max[0] = region.min[0];
+            return region;
+        }
+        for (int a = 0; a < 3; a++) {
+            region.min[a] = SIZE_MAX;
+            region.max[a] = 0u;
+        }
+        for (const size_t brick : working_set) {
+            const VoxelRegion r = brickRegion(brick);
+            for (int a = 0; a < 3; a++) {
+                region.min[a] = std::min(region.min[a], r.min[a]);
+                region.max[a] = std::max(region.max[a], r.max[a]);
+            }
+        }
+        return region;
+    }
+
+    /// Makes all bricks of the working set resident, evicting least recently used bricks outside of it if the memory
+    /// budget would be exceeded otherwise. Throws before reading any brick if the working set exceeds the budget.
+    void prefetch(const std::vector<size_t> &working_set) {
+        size_t working_set_bytes = 0u, missing_bytes = 0u;
+        for (const size_t brick : working_set) {
+            const size_t bytes = brickRegion(brick).voxels() * m_label_bytes;
+            working_set_bytes += bytes;
+            if (const auto it = m_bricks.find(brick); it != m_bricks.end()) {
+                // mark as most recently used so that it is evicted last
+                m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+                m_stats.hits++;
+            } else {
+                missing_bytes += bytes;
+            }
+        }
+        if (working_set_bytes > m_memory_budget)
+            throw std::runtime_error("brick working set of " + std::to_string(working_set_bytes)
+                                     + " bytes exceeds the memory budget of " + std::to_string(m_memory_budget)
+                                     + " bytes, narrow the split planes or raise the budget");
+
+        while (m_resident_bytes + missing_bytes > m_memory_budget)
+            evictLeastRecentlyUsed();
+
+        MiniTimer timer;
+        for (const size_t brick : working_set) {
+            if (m_bricks.contains(brick))
+                continue;
+            Brick &b = m_bricks[brick];
+            b.data = readBrick(brick);
+            m_lru.push_front(brick);
+            b.lru = m_lru.begin();
+            m_resident_bytes += b.data.size();
+            m_stats.misses++;
+            m_stats.bytes_read += b.data.size();
+        }
+        m_stats.read_seconds += timer.elapsed();
+    }
+
+    /// Creates an image that covers the bounding region of the working set. Resident bricks of the working set are
+    /// copied, all others are read from the file one after another directly into the image without caching them.
+    /// Voxels of bricks within the bounding region that are not part of the working set are set to label 0.
+    /// Least recently used bricks are evicted first if the image does not fit into the memory budget next to them.
+    /// Reading needs one additional brick of scratch memory. Throws if the image alone exceeds the memory budget.
+    /// @param region receives the voxel region of the volume that the image covers
+    [[nodiscard]] vtkSmartPointer<vtkImageData> assemble(const std::vector<size_t> &working_set, VoxelRegion &region) {
+        region = boundingRegion(working_set);
+        const size_t image_bytes = region.voxels() * m_label_bytes;
+        if (image_bytes > m_memory_budget)
+            throw std::runtime_error("assembled image of " + std::to_string(image_bytes) + " bytes for region "
+                                     + std::to_string(region.extent(0)) + "x" + std::to_string(region.extent(1)) + "x"
+                                     + std::to_string(region.extent(2)) + " exceeds the memory budget of "
+                                     + std::to_string(m_memory_budget) + " bytes, narrow the split planes or raise the budget");
+        while (m_resident_bytes + image_bytes > m_memory_budget)
+            evictLeastRecentlyUsed();
+
+        auto image = vtkSmartPointer<vtkImageData>::New();
+        image->SetDimensions(static_cast<int>(region.extent(0)), static_cast<int>(region.extent(1)),
+                             static_cast<int>(region.extent(2)));
+        image->AllocateScalars(m_label_type, 1);
+        if (region.empty())
+            return image;
+
+        // all bricks within the bounding region: copy resident working set bricks, clear the others
+        const std::vector<size_t> bricks = bricksWhere(region, [](const VoxelRegion &) { return true; });
+        std::vector<size_t> sorted_working_set(working_set);
+        std::ranges::sort(sorted_working_set);
+        char *dst = static_cast<char *>(image->GetScalarPointer());
+        parallel_for(bricks.size(), m_thread_count, [&](const size_t i, unsigned) {
+            const auto it = m_bricks.find(bricks[i]);
+            if (it != m_bricks.end() && std::ranges::binary_search(sorted_working_set, bricks[i]))
+                copyBrick(brickRegion(bricks[i]), it->second.data.data(), region, dst);
+            else
+                copyBrick(brickRegion(bricks[i]), nullptr, region, dst);
+        });
+
+        // read the missing working set bricks, each read decompresses its chunks in parallel
+        MiniTimer timer;
+        for (const size_t brick : working_set) {
+            if (const auto it = m_bricks.find(brick); it != m_bricks.end()) {
+                m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+                m_stats.hits++;
+                continue;
+            }
+            const std::vector<char> data = readBrick(brick);
+            copyBrick(brickRegion(brick), data.data(), region, dst);
+            m_stats.misses++;
+            m_stats.bytes_read += data.size();
+        }
+        m_stats.read_seconds += timer.elapsed();
+        return image;
+    }
+
+  private:
+    struct Brick {
+        std::vector<char> data;
+        std::list<size_t>::iterator lru;
+    };
+
+    /// @return the labels of the brick read from the file
+    [[nodiscard]] std::vector<char> readBrick(const size_t brick) const {
+        const VoxelRegion region = brickRegion(brick);
+        std::vector<char> data(region.voxels() * m_label_bytes);
+#ifdef LIB_HIGHFIVE
+        size_t dim[3];
+        visitLabelType(m_label_type, [&](auto label) {
+            using T = decltype(label);
+            read_hdf5_chunked<T>(*m_dataset, dim, reinterpret_cast<T *>(data.data()), m_thread_count, region);
+        });
+#endif
+        return data;
+    }
+
+    /// Copies the labels of a brick covering r to its location in the image of the region, clearing it if src is null.
+    void copyBrick(const VoxelRegion &r, const char *src, const VoxelRegion &region, char *dst) const {
+        const size_t row_bytes = r.extent(0) * m_label_bytes;
+        for (size_t z = 0; z < r.extent(2); z++) {
+            for (size_t y = 0; y < r.extent(1); y++) {
+                char *dst_row = dst + (((r.min[2] + z - region.min[2]) * region.extent(1) + (r.min[1] + y - region.min[1]))
+                                       * region.extent(0) + (r.min[0] - region.min[0])) * m_label_bytes;
+                if (src)
+                    std::memcpy(dst_row, src + (z * r.extent(1) + y) * row_bytes, row_bytes);
+                else
+                    std::memset(dst_row, 0, row_bytes);
+            }
+        }
+    }
+
+    void evictLeastRecentlyUsed() {
+        if (m_lru.empty())
+            throw std::runtime_error("brick cache is empty but exceeds the memory budget");
+        const auto it = m_bricks.find(m_lru.back());
+        m_resident_bytes -= it->second.data.size();
+        m_bricks.erase(it);
+        m_lru.pop_back();
+        m_stats.evictions++;
+    }
+
+    std::string m_url;
+#ifdef LIB_HIGHFIVE
+    std::unique_ptr<HighFive::File> m_file;
+    std::unique_ptr<HighFive::DataSet> m_dataset;
+#endif
+    size_t m_dim[3] = {0u, 0u, 0u};
+    int m_label_type = 0;
+    size_t m_label_bytes = 0u;
+    size_t m_brick_size;
+    size_t m_brick_count[3] = {0u, 0u, 0u};
+    size_t m_memory_budget;
+    unsigned m_thread_count;
+
+    std::unordered_map<size_t, Brick> m_bricks;
+    std::list<size_t> m_lru;        ///< resident bricks, most recently used first
+    size_t m_resident_bytes = 0u;
+    Statistics m_stats;
+};
+
+} // namespace vvv
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cmath>
+#include <fstream>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Camera.hpp"
+
+namespace vvv {
+
+/// Procedural animation of an orbital Volcanite camera for benchmarks with view dependent costs. A path maps a
+/// parameter t in [0, 1] to a camera.
+class CameraPath {
+  public:
+    enum class Type { Orbit, Dolly, FlyThrough };
+
+    /// Full turn around the look at point by increasing rotation_y.
+    static CameraPath orbit(const Camera &start) { return CameraPath(Type::Orbit, {start}); }
+
+    /// Moves the camera from its orbital radius towards the look at point down to radius * min_scale and back.
+    static CameraPath dolly(const Camera &start, const float min_scale = 0.25f) {
+        CameraPath path(Type::Dolly, {start});
+        path.m_min_scale = min_scale;
+        return path;
+    }
+
+    /// Catmull-Rom spline through the camera positions and look at points of the keyframes.
+    static CameraPath flyThrough(std::vector<Camera> keyframes) {
+        if (keyframes.size() < 2u)
+            throw std::invalid_argument("a fly-through requires at least two camera keyframes");
+        return CameraPath(Type::FlyThrough, std::move(keyframes));
+    }
+
+    /// Reads keyframes stored one after another in the human readable format of Camera::writeTo.
+    static std::vector<Camera> readKeyframes(const std::string &path) {
+        std::ifstream in(path);
+        if (!in.is_open())
+            throw std::runtime_error("could not open camera keyframe file " + path);
+        std::vector<Camera> keyframes;
+        while (true) {
+            Camera camera;
+            camera.readFrom(in, true);
+            if (in.fail())
+                break;
+            keyframes.push_back(camera);
+        }
+        return keyframes;
+    }
+
+    [[nodiscard]] Type type() const { return m_type; }
+
+    /// @return true if the camera at t = 1 equals the camera at t = 0
+    [[nodiscard]] bool closed() const { return m_type != Type::FlyThrough; }
+
+    [[nodiscard]] static std::string name(const Type type) {
+        switch (type) {
+        case Type::Orbit:
+            return "orbit";
+        case Type::Dolly:
+            return "dolly";
+        case Type::FlyThrough:
+            return "flythrough";
+        default:
+            throw std::invalid_argument("invalid camera path type");
+        }
+    }
+
+    [[nodiscard]] Camera at(const float t) const {
+        Camera camera = m_keyframes[0];
+        switch (m_type) {
+        case Type::Orbit:
+            camera.rotation_y += 2.f * std::numbers::pi_v<float> * t;
+            break;
+        case Type::Dolly:
+            camera.orbital_radius *= glm::mix(1.f, m_min_scale, 0.5f - 0.5f * std::cos(2.f * std::numbers::pi_v<float> * t));
+            break;
+        case Type::FlyThrough: {
+            // segment i interpolates keyframes i and i + 1, the end points are repeated as outer control points
+            const int segments = static_cast<int>(m_keyframes.size()) - 1;
+            const float x = glm::clamp(t, 0.f, 1.f) * static_cast<float>(segments);
+            const int i = glm::min(static_cast<int>(x), segments - 1);
+            const float s = x - static_cast<float>(i);
+            const auto key = [&](const int k) -> Camera {
+                Camera c = m_keyframes[glm::clamp(k, 0, segments)];
+                c.get_position();
+                return c;
+            };
+            const Camera k0 = key(i - 1), k1 = key(i), k2 = key(i + 1), k3 = key(i + 2);
+            const glm::vec3 look_at = catmullRom(k0.position_look_at_world_space, k1.position_look_at_world_space,
+                                                 k2.position_look_at_world_space, k3.position_look_at_world_space, s);
+            const glm::vec3 position = catmullRom(k0.position_world_space, k1.position_world_space,
+                                                  k2.position_world_space, k3.position_world_space, s);
+            // express the position in the orbital parameters around the look at point
+            const glm::vec3 d = position - look_at;
+            camera.position_look_at_world_space = look_at;
+            camera.orbital_radius = glm::max(glm::length(d), 1.e-6f);
+            camera.rotation_x = std::asin(glm::clamp(d.y / camera.orbital_radius, -1.f, 1.f));
+            camera.rotation_y = std::atan2(d.z, d.x);
+            break;
+        }
+        }
+        camera.get_position();
+        return camera;
+    }
+
+  private:
+    CameraPath(const Type type, std::vector<Camera> keyframes) : m_type(type), m_keyframes(std::move(keyframes)) {}
+
+    static glm::vec3 catmullRom(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3,
+                                const float s) {
+        return 0.5f * (2.f * p1 + (p2 - p0) * s + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * s * s
+                       + (3.f * p1 - p0 - 3.f * p2 + p3) * s * s * s);
+    }
+
+    Type m_type;
+    std::vector<Camera> m_keyframes;
+    float m_min_scale = 0.25f;
+};
+
+} // namespace vvv
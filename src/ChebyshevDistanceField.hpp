@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "OccupancyGrid.hpp"
+#include "parallel.hpp"
+
+namespace vvv {
+
+/// Replaces each line of values f along the given axis by g(i) = min_j max(|i - j|, f(j)), capped at max_value.
+/// Applying it along x, y and z to a field that is 0 at occupied voxels and max_value elsewhere yields the exact
+/// Chebyshev (L-inf) distance to the nearest occupied voxel. Lines are processed in parallel. Since g is 1-Lipschitz,
+/// each value is found in a few range minimum queries on a sparse table of the line.
+inline void chebyshevTransformAxis(uint8_t *field, const int (&dim)[3], const int axis, const uint8_t max_value,
+                                   const unsigned thread_count = 0u) {
+    const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    const size_t stride[3] = {1u, static_cast<size_t>(dim[0]), static_cast<size_t>(dim[0]) * dim[1]};
+    const auto n = static_cast<size_t>(dim[axis]);
+    const int levels = std::bit_width(n);
+
+    // sparse table of range minima per worker thread: table[k * n + i] = min f[i, i + 2^k)
+    std::vector<std::vector<uint8_t>> tables(resolve_thread_count(thread_count));
+    parallel_for(static_cast<size_t>(dim[u]) * dim[v], thread_count, [&](const size_t line, const unsigned thread_idx) {
+        std::vector<uint8_t> &table = tables[thread_idx];
+        table.resize(levels * n);
+        uint8_t *values = field + (line % dim[u]) * stride[u] + (line / dim[u]) * stride[v];
+        for (size_t i = 0; i < n; i++)
+            table[i] = values[i * stride[axis]];
+        for (int k = 1; k < levels; k++) {
+            const size_t half = size_t{1} << (k - 1);
+            for (size_t i = 0; i + (half << 1) <= n; i++)
+                table[k * n + i] = std::min(table[(k - 1) * n + i], table[(k - 1) * n + i + half]);
+        }
+        const auto range_min = [&](const size_t lo, const size_t hi) {
+            const int k = std::bit_width(hi - lo + 1u) - 1;
+            return std::min(table[k * n + lo], table[k * n + hi + 1u - (size_t{1} << k)]);
+        };
+
+        size_t r = 0u;
+        for (size_t i = 0; i < n; i++) {
+            r = r > 0u ? r - 1u : 0u;
+            while (r < max_value && range_min(i >= r ? i - r : 0u, std::min(n - 1u, i + r)) > r)
+                r++;
+            values[i * stride[axis]] = static_cast<uint8_t>(r);
+        }
+    });
+}
+
+/// Chebyshev (L-inf) distance of each voxel to the nearest occupied voxel, capped at 255. A ray at a voxel with
+/// distance d can leap over the empty cube of radius d - 1 around it in a single step.
+class ChebyshevDistanceField {
+  public:
+    static constexpr uint8_t MAX_DISTANCE = 255u;
+
+    ChebyshevDistanceField() = default;
+
+    /// Computes the distance field separably from the finest level of the occupancy grid.
+    explicit ChebyshevDistanceField(const OccupancyGrid &occupancy, const unsigned thread_count = 0u) {
+        const glm::ivec3 d = occupancy.dimensions();
+        m_dim[0] = d.x;
+        m_dim[1] = d.y;
+        m_dim[2] = d.z;
+        m_distance.resize(static_cast<size_t>(d.x) * d.y * d.z);
+        parallel_for(static_cast<size_t>(d.y) * d.z, thread_count, [&](const size_t yz, unsigned) {
+            const glm::ivec3 v(0, static_cast<int>(yz % d.y), static_cast<int>(yz / d.y));
+            uint8_t *row = m_distance.data() + yz * d.x;
+            for (int x = 0; x < d.x; x++)
+                row[x] = occupancy.occupied(0, {x, v.y, v.z}) ? 0u : MAX_DISTANCE;
+        });
+        for (int axis = 0; axis < 3; axis++)
+            chebyshevTransformAxis(m_distance.data(), m_dim, axis, MAX_DISTANCE, thread_count);
+    }
+
+    [[nodiscard]] uint8_t distance(const glm::ivec3 &voxel) const {
+        return m_distance[(static_cast<size_t>(voxel.z) * m_dim[1] + voxel.y) * m_dim[0] + voxel.x];
+    }
+
+    [[nodiscard]] size_t bytes() const { return m_distance.size(); }
+
+    /// Finds the first occupied voxel along the ray within [t_enter, t_exit) by leaping over the empty cube around
+    /// the current voxel whose radius is given by the distance field. Parameters are as in OccupancyGrid::firstHit.
+    [[nodiscard]] bool firstHit(const glm::vec3 &origin, const glm::vec3 &dir, float t_enter, const float t_exit,
+                                glm::ivec3 voxel, int enter_axis, OccupancyGrid::Hit &hit) const {
+        const glm::ivec3 step(dir.x >= 0.f ? 1 : -1, dir.y >= 0.f ? 1 : -1, dir.z >= 0.f ? 1 : -1);
+        const glm::vec3 inv_dir = 1.f / dir;
+        const glm::ivec3 dim(m_dim[0], m_dim[1], m_dim[2]);
+        float t = t_enter;
+        while (t < t_exit) {
+            if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(voxel, dim)))
+                return false;
+            const int d = distance(voxel);
+            if (d == 0) {
+                hit = {voxel, t, enter_axis};
+                return true;
+            }
+
+            // leave the empty cube through its nearest face
+            const glm::ivec3 lo = voxel - (d - 1), hi = voxel + d;
+            float t_next = INFINITY;
+            int axis = 0;
+            for (int a = 0; a < 3; a++) {
+                if (dir[a] == 0.f)
+                    continue;
+                const float t_face = (static_cast<float>(step[a] > 0 ? hi[a] : lo[a]) - origin[a]) * inv_dir[a];
+                if (t_face < t_next) {
+                    t_next = t_face;
+                    axis = a;
+                }
+            }
+            const glm::vec3 p = origin + t_next * dir;
+            for (int a = 0; a < 3; a++)
+                voxel[a] = a == axis ? (step[a] > 0 ? hi[a] : lo[a] - 1)
+                                     : glm::clamp(static_cast<int>(std::floor(p[a])), lo[a], hi[a] - 1);
+            t = std::max(t, t_next);
+            enter_axis = axis;
+        }
+        return false;
+    }
+
+  private:
+    int m_dim[3] = {0, 0, 0};
+    std::vector<uint8_t> m_distance;
+};
+
+} // namespace vvv
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ChebyshevDistanceField.hpp"
+#include "intervals.hpp"
+#include "OccupancyGrid.hpp"
+#include "parallel.hpp"
+#include "util.hpp"
+
+namespace vvv {
+
+/// Visibility of labels as given by the merged opacity intervals. Labels up to a limit are looked up in a bit set,
+/// larger labels fall back to a binary search in the intervals.
+class LabelVisibility {
+  public:
+    LabelVisibility() = default;
+
+    /// @param merged sorted, non-overlapping visible intervals as returned by mergeIntervals
+    /// @param label_max largest label that is looked up frequently
+    LabelVisibility(std::vector<Interval> merged, const uint32_t label_max) : m_intervals(std::move(merged)) {
+        const size_t bit_count = std::min<size_t>(static_cast<size_t>(label_max) + 1u, MAX_BITS);
+        m_bits.assign((bit_count + 63u) / 64u, 0u);
+        for (const auto &i : m_intervals) {
+            for (size_t l = i.start; l <= i.end && l < bit_count; l++)
+                m_bits[l / 64u] |= uint64_t{1} << (l % 64u);
+        }
+    }
+
+    [[nodiscard]] bool operator()(const uint32_t label) const {
+        if (label / 64u < m_bits.size())
+            return (m_bits[label / 64u] >> (label % 64u)) & 1u;
+        return intervalsContain(m_intervals, label);
+    }
+
+  private:
+    static constexpr size_t MAX_BITS = size_t{1} << 26;
+
+    std::vector<Interval> m_intervals;
+    std::vector<uint64_t> m_bits;
+};
+
+/// Opaque first-hit ray caster for segmentation volumes on the CPU. All visible labels are fully opaque, so each ray
+/// traverses the occupancy grid of visible voxels with a hierarchical DDA and stops at the first occupied voxel. The
+/// hit voxel face is shaded with a headlight using the Phong coefficients of the VTK volume property. Image tiles are
+/// distributed across all worker threads, each of which traces packets of PACKET_SIZE neighboring rays in lockstep.
+class FirstHitRayCaster {
+  public:
+    /// Phong shading coefficients and background color, matching the VTK volume property and renderer.
+    struct Shading {
+        float ambient = 0.1f;
+        float diffuse = 0.7f;
+        float specular = 0.2f;
+        float specular_power = 10.f;
+        glm::vec3 background = glm::vec3(1.f);
+    };
+
+    /// @param image label volume, must outlive the ray caster
+    /// @param visible sorted, non-overlapping visible intervals as returned by mergeIntervals
+    /// @param colors color of each label, sampled uniformly over [0, label_max]
+    /// @param thread_count number of threads for preprocessing, 0 for all hardware threads
+    FirstHitRayCaster(vtkImageData *image, std::vector<Interval> visible, std::vector<glm::vec3> colors,
+                      const uint32_t label_max, const unsigned thread_count = 0u)
+        : m_image(image), m_colors(std::move(colors)), m_label_max(label_max), m_thread_count(thread_count) {
+        image->GetDimensions(m_dim);
+        visitLabelType(image->GetScalarType(), [&](auto label) {
+            using T = decltype(label);
+            m_bricks = LabelBrickSummary(static_cast<const T *>(image->GetScalarPointer()), m_dim, 16, thread_count);
+        });
+        setVisibleIntervals(std::move(visible));
+        double spacing[3];
+        image->GetSpacing(spacing);
+        m_spacing = glm::vec3(spacing[0], spacing[1], spacing[2]);
+        m_crop_min = glm::vec3(0.f);
+        m_crop_max = glm::vec3(m_dim[0], m_dim[1], m_dim[2]);
+    }
+
+    /// Reclassifies the volume for new visible intervals. Bricks without visible labels are found from the brick
+    /// label summary, only the voxels of the remaining bricks are read to rebuild the occupancy grid.
+    void setVisibleIntervals(std::vector<Interval> visible) {
+        const std::vector<uint8_t> brick_visible = m_bricks.classify(visible, m_thread_count);
+        const LabelVisibility visibility(std::move(visible), m_label_max);
+        visitLabelType(m_image->GetScalarType(), [&](auto label) {
+            using T = decltype(label);
+            m_occupancy = OccupancyGrid(static_cast<const T *>(m_image->GetScalarPointer()), m_dim, visibility,
+                                        m_thread_count, &m_bricks, brick_visible);
+        });
+        if (m_distance_leaping)
+            m_distance_field = ChebyshevDistanceField(m_occupancy, m_thread_count);
+    }
+
+    /// Leap over empty space with a Chebyshev distance field instead of the hierarchical occupancy grid. The distance
+    /// field costs one byte per voxel.
+    void setDistanceLeaping(const bool enable) {
+        m_distance_leaping = enable;
+        m_distance_field = enable ? ChebyshevDistanceField(m_occupancy, m_thread_count) : ChebyshevDistanceField();
+    }
+
+    /// @param voxel_to_clip transformation from voxel index coordinates into clip space, voxel centers are at integers
+    void setCamera(const glm::mat4 &voxel_to_clip) { m_clip_to_voxel = glm::inverse(voxel_to_clip); }
+
+    /// Restricts rendering to a box in voxel index coordinates, e.g. the split planes.
+    void setCropping(const glm::vec3 &min, const glm::vec3 &max) {
+        // voxels are cells [i - 0.5, i + 0.5] around their centers
+        m_crop_min = glm::max(min + 0.5f, glm::vec3(0.f));
+        m_crop_max = glm::min(max + 0.5f, glm::vec3(m_dim[0], m_dim[1], m_dim[2]));
+    }
+
+    void setShading(const Shading &shading) { m_shading = shading; }
+
+    /// Renders an RGBA image with rows from bottom to top.
+    void render(const int width, const int height, std::vector<uint8_t> &rgba, const unsigned thread_count = 0u) const {
+        rgba.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * 4u);
+        const int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+        const int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+        visitLabelType(m_image->GetScalarType(), [&](auto label) {
+            using T = decltype(label);
+            const T *labels = static_cast<const T *>(m_image->GetScalarPointer());
+            parallel_for(static_cast<size_t>(tiles_x * tiles_y), thread_count, [&](const size_t tile, unsigned) {
+                const int x0 = static_cast<int>(tile % tiles_x) * TILE_SIZE;
+                const int y0 = static_cast<int>(tile / tiles_x) * TILE_SIZE;
+                const int x1 = std::min(x0 + TILE_SIZE, width);
+                glm::vec3 c[PACKET_SIZE];
+                for (int y = y0; y < std::min(y0 + TILE_SIZE, height); y++) {
+                    for (int x = x0; x < x1; x += PACKET_SIZE) {
+                        const int lanes = std::min(PACKET_SIZE, x1 - x);
+                        // the distance field leaps per ray, packets are traced through the occupancy hierarchy
+                        if (m_distance_leaping) {
+                            for (int l = 0; l < lanes; l++)
+                                c[l] = trace(labels, x + l, y, width, height);
+                        } else {
+                            tracePacket(labels, x, y, lanes, width, height, c);
+                        }
+                        for (int l = 0; l < lanes; l++) {
+                            uint8_t *px = rgba.data() + (static_cast<size_t>(y) * width + x + l) * 4u;
+                            for (int i = 0; i < 3; i++)
+                                px[i] = static_cast<uint8_t>(glm::clamp(c[l][i], 0.f, 1.f) * 255.f + 0.5f);
+                            px[3] = 255u;
+                        }
+                    }
+                }
+            });
+        });
+    }
+
+  private:
+    static constexpr int TILE_SIZE = 16;
+    static constexpr int PACKET_SIZE = 8;
+
+    /// Primary ray of a pixel in voxel cell space where voxel i covers [i, i+1), clipped against the cropping box.
+    struct Ray {
+        glm::vec3 origin, dir;
+        float t_enter, t_exit;
+        glm::ivec3 voxel;   ///< voxel that contains the ray at t_enter
+        int enter_axis;     ///< axis of the cropping box face through which the ray enters, -1 if it starts inside
+    };
+
+    [[nodiscard]] glm::vec3 color(const uint32_t label) const {
+        if (m_label_max == 0u || m_colors.size() <= 1u)
+            return m_colors.empty() ? glm::vec3(1.f) : m_colors[0];
+        const uint64_t idx = (static_cast<uint64_t>(std::min(label, m_label_max)) * (m_colors.size() - 1u) + m_label_max / 2u) / m_label_max;
+        return m_colors[idx];
+    }
+
+    /// @return false if the ray of the pixel misses the cropping box
+    [[nodiscard]] bool primaryRay(const int x, const int y, const int width, const int height, Ray &ray) const {
+        // unproject the pixel center at the near and far plane into voxel cell space
+        const float ndc_x = (2.f * static_cast<float>(x) + 1.f) / static_cast<float>(width) - 1.f;
+        const float ndc_y = (2.f * static_cast<float>(y) + 1.f) / static_cast<float>(height) - 1.f;
+        const glm::vec4 p_near = m_clip_to_voxel * glm::vec4(ndc_x, ndc_y, -1.f, 1.f);
+        const glm::vec4 p_far = m_clip_to_voxel * glm::vec4(ndc_x, ndc_y, 1.f, 1.f);
+        const glm::vec3 origin = glm::vec3(p_near) / p_near.w + 0.5f;
+        // stays valid for far planes at infinity (p_far.w = 0)
+        const glm::vec3 dir = glm::vec3(p_far) * p_near.w - glm::vec3(p_near) * p_far.w;
+
+        // clip the ray against the cropping box
+        float t_enter = 0.f, t_exit = INFINITY;
+        int enter_axis = -1;
+        for (int a = 0; a < 3; a++) {
+            if (dir[a] == 0.f) {
+                if (origin[a] < m_crop_min[a] || origin[a] >= m_crop_max[a])
+                    return false;
+                continue;
+            }
+            float t0 = (m_crop_min[a] - origin[a]) / dir[a];
+            float t1 = (m_crop_max[a] - origin[a]) / dir[a];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            if (t0 > t_enter) {
+                t_enter = t0;
+                enter_axis = a;
+            }
+            t_exit = std::min(t_exit, t1);
+        }
+        if (t_enter >= t_exit)
+            return false;
+
+        const glm::vec3 p = origin + t_enter * dir;
+        for (int a = 0; a < 3; a++)
+            ray.voxel[a] = glm::clamp(static_cast<int>(std::floor(p[a])), static_cast<int>(std::floor(m_crop_min[a])),
+                                      static_cast<int>(std::ceil(m_crop_max[a])) - 1);
+        ray.origin = origin;
+        ray.dir = dir;
+        ray.t_enter = t_enter;
+        ray.t_exit = t_exit;
+        ray.enter_axis = enter_axis;
+        return true;
+    }
+
+    template <typename T>
+    [[nodiscard]] glm::vec3 shadeHit(const T *labels, const glm::ivec3 &voxel, const glm::vec3 &dir, const int axis) const {
+        const size_t stride_y = static_cast<size_t>(m_dim[0]), stride_z = stride_y * static_cast<size_t>(m_dim[1]);
+        const auto label = static_cast<uint32_t>(labels[voxel.x + voxel.y * stride_y + voxel.z * stride_z]);
+        return shade(color(label), dir, axis);
+    }
+
+    template <typename T>
+    [[nodiscard]] glm::vec3 trace(const T *labels, const int x, const int y, const int width, const int height) const {
+        Ray ray;
+        if (!primaryRay(x, y, width, height, ray))
+            return m_shading.background;
+        // skip empty space with a hierarchical DDA through the occupancy grid or by distance field leaping
+        OccupancyGrid::Hit hit;
+        const bool found = m_distance_leaping
+                               ? m_distance_field.firstHit(ray.origin, ray.dir, ray.t_enter, ray.t_exit, ray.voxel, ray.enter_axis, hit)
+                               : m_occupancy.firstHit(ray.origin, ray.dir, ray.t_enter, ray.t_exit, ray.voxel, ray.enter_axis, hit);
+        if (!found)
+            return m_shading.background;
+        return shadeHit(labels, hit.voxel, ray.dir, hit.axis);
+    }
+
+    /// Traces the rays of up to PACKET_SIZE consecutive pixels of a row in lockstep through the occupancy grid.
+    template <typename T>
+    void tracePacket(const T *labels, const int x, const int y, const int lanes, const int width, const int height,
+                     glm::vec3 (&colors)[PACKET_SIZE]) const {
+        OccupancyGrid::RayPacket<PACKET_SIZE> packet;
+        for (int l = 0; l < PACKET_SIZE; l++) {
+            Ray ray;
+            packet.active[l] = l < lanes && primaryRay(x + l, y, width, height, ray);
+            if (!packet.active[l])
+                continue;
+            for (int a = 0; a < 3; a++) {
+                packet.origin[a][l] = ray.origin[a];
+                packet.dir[a][l] = ray.dir[a];
+                packet.voxel[a][l] = ray.voxel[a];
+            }
+            packet.t[l] = ray.t_enter;
+            packet.t_exit[l] = ray.t_exit;
+            packet.enter_axis[l] = ray.enter_axis;
+        }
+        m_occupancy.firstHits(packet);
+        for (int l = 0; l < lanes; l++) {
+            colors[l] = packet.hit[l] ? shadeHit(labels, {packet.voxel[0][l], packet.voxel[1][l], packet.voxel[2][l]},
+                                                 {packet.dir[0][l], packet.dir[1][l], packet.dir[2][l]}, packet.enter_axis[l])
+                                      : m_shading.background;
+        }
+    }
+
+    /// Shades the hit face perpendicular to the given voxel axis with a headlight. The volume transformation only
+    /// permutes and flips axes, so the angle is computed from the ray direction scaled to world space.
+    [[nodiscard]] glm::vec3 shade(const glm::vec3 &albedo, const glm::vec3 &dir, const int axis) const {
+        // rays starting within a visible voxel have no hit face and are lit head-on
+        float cos_angle = 1.f;
+        if (axis >= 0) {
+            const glm::vec3 world_dir = dir * m_spacing;
+            cos_angle = std::abs(world_dir[axis]) / glm::length(world_dir);
+        }
+        return albedo * (m_shading.ambient + m_shading.diffuse * cos_angle)
+               + glm::vec3(m_shading.specular * std::pow(cos_angle, m_shading.specular_power));
+    }
+
+    vtkImageData *m_image;
+    std::vector<glm::vec3> m_colors;
+    uint32_t m_label_max;
+    unsigned m_thread_count;
+    int m_dim[3];
+    glm::vec3 m_spacing;
+    LabelBrickSummary m_bricks;
+    OccupancyGrid m_occupancy;
+    bool m_distance_leaping = false;
+    ChebyshevDistanceField m_distance_field;
+    glm::mat4 m_clip_to_voxel = glm::mat4(1.f);
+    glm::vec3 m_crop_min, m_crop_max;
+    Shading m_shading;
+};
+
+} // namespace vvv
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef LIB_HIGHFIVE
+    #include <highfive/H5File.hpp>
+#endif
+
+#include "intervals.hpp"
+#include "parallel.hpp"
+#include "read_vcfg_tf.hpp"
+
+namespace vvv {
+
+/// Per-label attribute table stored column by column. Attribute 0 is the label itself, attribute k > 0 is the k-th
+/// stored column. Each column holds one value per label in [0, labelCount()), labels without a value are NaN.
+class LabelAttributes {
+  public:
+    /// Largest label id that is accepted in attribute files, as columns are stored densely.
+    static constexpr uint32_t MAX_LABEL = (1u << 28) - 1u;
+
+    /// Reads a .csv file whose header names the columns. The first column holds the label, the following columns its
+    /// attributes 1, 2, ... Rows may be listed in any order and labels may be missing.
+    static LabelAttributes readCsv(const std::filesystem::path &path) {
+        std::ifstream in(path);
+        if (!in.is_open())
+            throw std::runtime_error("could not open attribute file " + path.string());
+
+        LabelAttributes attributes;
+        std::string line;
+        std::getline(in, line);
+        std::istringstream header(line);
+        std::string name;
+        std::getline(header, name, ',');
+        while (std::getline(header, name, ',')) {
+            attributes.m_names.push_back(name);
+            attributes.m_columns.emplace_back();
+        }
+
+        size_t row = 1u;
+        while (std::getline(in, line)) {
+            row++;
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            const char *c = line.c_str();
+            char *end;
+            const double label = std::strtod(c, &end);
+            if (end == c || label < 0. || label > MAX_LABEL || label != std::floor(label))
+                throw std::runtime_error("invalid label in line " + std::to_string(row) + " of " + path.string());
+            attributes.resize(static_cast<size_t>(label) + 1u);
+            for (auto &column : attributes.m_columns) {
+                if (*end != ',')
+                    throw std::runtime_error("missing attribute in line " + std::to_string(row) + " of " + path.string());
+                c = end + 1;
+                column[static_cast<size_t>(label)] = std::strtof(c, &end);
+                if (end == c)
+                    throw std::runtime_error("invalid attribute in line " + std::to_string(row) + " of " + path.string());
+            }
+        }
+        return attributes;
+    }
+
+    /// Reads all one dimensional data sets of an .hdf5 file as attribute columns indexed by label, in the order in
+    /// which they are listed in the file.
+    static LabelAttributes readHdf5(const std::filesystem::path &path) {
+#ifdef LIB_HIGHFIVE
+        HighFive::File file(path.string(), HighFive::File::ReadOnly);
+        LabelAttributes attributes;
+        for (const auto &name : file.listObjectNames()) {
+            if (file.getObjectType(name) != HighFive::ObjectType::Dataset)
+                continue;
+            const auto dataset = file.getDataSet(name);
+            if (dataset.getDimensions().size() != 1u)
+                continue;
+            if (dataset.getDimensions()[0] > static_cast<size_t>(MAX_LABEL) + 1u)
+                throw std::runtime_error("attribute data set " + name + " exceeds the maximum label count");
+            std::vector<float> column;
+            dataset.read(column);
+            attributes.m_names.push_back(name);
+            attributes.m_columns.push_back(std::move(column));
+            attributes.resize(std::max(attributes.m_label_count, attributes.m_columns.back().size()));
+        }
+        return attributes;
+#else
+        throw std::runtime_error("HighFIVE / HDF5 libraries not found! Cannot load .hdf5 attribute file!");
+#endif
+    }
+
+    /// Reads attributes from an .hdf5 or .csv file depending on its extension.
+    static LabelAttributes read(const std::filesystem::path &path) {
+        if (path.extension() == ".hdf5" || path.extension() == ".h5")
+            return readHdf5(path);
+        return readCsv(path);
+    }
+
+    /// @return the number of labels covered by the table, larger labels have no attributes
+    [[nodiscard]] size_t labelCount() const { return m_label_count; }
+    /// @return the number of attributes including the label itself
+    [[nodiscard]] int attributeCount() const { return static_cast<int>(m_columns.size()) + 1; }
+    [[nodiscard]] const std::string &name(const int attribute) const { return m_names[attribute - 1]; }
+    /// @return the values of all labels for an attribute k > 0
+    [[nodiscard]] const std::vector<float> &column(const int attribute) const { return m_columns[attribute - 1]; }
+
+  private:
+    void resize(const size_t label_count) {
+        if (label_count <= m_label_count)
+            return;
+        m_label_count = label_count;
+        for (auto &column : m_columns)
+            column.resize(label_count, std::numeric_limits<float>::quiet_NaN());
+    }
+
+    size_t m_label_count = 0u;
+    std::vector<std::string> m_names;
+    std::vector<std::vector<float>> m_columns;
+};
+
+/// Material id of labels that do not belong to any material.
+constexpr uint8_t NO_MATERIAL = 0xFFu;
+
+/// @return true if the material selects labels by their label id instead of a stored attribute
+inline bool discriminatesLabel(const SegmentedVolumeMaterial &material) {
+    return material.discrAttribute == SegmentedVolumeMaterial::DISCR_ANY || material.discrAttribute == 0;
+}
+
+/// @return true if the labels of the material are rendered: it is enabled and not fully transparent. Labels of an
+///         enabled but transparent material still belong to it and are hidden, not passed on to later materials.
+inline bool materialVisible(const SegmentedVolumeMaterial &material) {
+    return material.discrAttribute != SegmentedVolumeMaterial::DISCR_NONE && material.opacity > 0.f;
+}
+
+/// Evaluates the discrimination intervals of all materials for each label in [0, attributes.labelCount()). Each label
+/// is assigned the first enabled material (discrAttribute != DISCR_NONE) whose attribute lies within its interval,
+/// even if that material is transparent. Materials are evaluated one after
+/// another in reverse order with a branchless select over contiguous attribute columns, in parallel label blocks.
+/// @return the material id of each label, NO_MATERIAL if no material contains it
+inline std::vector<uint8_t> classifyLabelMaterials(const std::vector<SegmentedVolumeMaterial> &materials,
+                                                   const LabelAttributes &attributes, const unsigned thread_count = 0u) {
+    if (materials.size() >= NO_MATERIAL)
+        throw std::invalid_argument("at most " + std::to_string(NO_MATERIAL - 1) + " materials are supported");
+    for (const auto &m : materials) {
+        if (m.discrAttribute >= attributes.attributeCount())
+            throw std::invalid_argument("material attribute " + std::to_string(m.discrAttribute) + " is not in the attribute table");
+    }
+
+    std::vector<uint8_t> ids(attributes.labelCount(), NO_MATERIAL);
+    parallel_for_blocks(ids.size(), 1u << 14, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+        uint8_t *id = ids.data();
+        for (size_t m = materials.size(); m-- > 0u;) {
+            const auto &material = materials[m];
+            if (material.discrAttribute == SegmentedVolumeMaterial::DISCR_NONE)
+                continue;
+            const float lo = material.discrInterval[0], hi = material.discrInterval[1];
+            const auto mid = static_cast<uint8_t>(m);
+            if (discriminatesLabel(material)) {
+                for (size_t l = begin; l < end; l++) {
+                    const auto v = static_cast<float>(l);
+                    id[l] = (v >= lo) & (v <= hi) ? mid : id[l];
+                }
+            } else {
+                const float *values = attributes.column(material.discrAttribute).data();
+                for (size_t l = begin; l < end; l++)
+                    id[l] = (values[l] >= lo) & (values[l] <= hi) ? mid : id[l];
+            }
+        }
+    });
+    return ids;
+}
+
+/// @param label_materials material ids of the labels in [0, label_materials.size()) from classifyLabelMaterials
+/// @return the material of the label or NO_MATERIAL. Labels outside the attribute table can only belong to materials
+///         that discriminate label ids.
+inline uint8_t labelMaterial(const std::vector<SegmentedVolumeMaterial> &materials,
+                             const std::vector<uint8_t> &label_materials, const uint32_t label) {
+    if (label < label_materials.size())
+        return label_materials[label];
+    for (size_t m = 0; m < materials.size(); m++) {
+        const auto &material = materials[m];
+        if (material.discrAttribute != SegmentedVolumeMaterial::DISCR_NONE && discriminatesLabel(material)
+            && static_cast<float>(label) >= material.discrInterval[0] && static_cast<float>(label) <= material.discrInterval[1])
+            return static_cast<uint8_t>(m);
+    }
+    return NO_MATERIAL;
+}
+
+/// Labels in the label id range of several materials belong to the first one, as in labelMaterial.
+/// @param selection flag of each material, only labels of visible materials with a set flag are collected
+/// @param first_label only labels from here on are collected
+/// @param label_ranges also treat materials that discriminate other attributes as label id ranges
+/// @return the merged label intervals of all labels that belong to a selected visible material by their label id
+inline std::vector<Interval> materialLabelRanges(const std::vector<SegmentedVolumeMaterial> &materials,
+                                                 const std::vector<uint8_t> &selection, const uint32_t first_label = 0u,
+                                                 const bool label_ranges = false) {
+    // labels claimed by earlier materials
+    std::vector<Interval> claimed, intervals;
+    for (size_t i = 0; i < materials.size(); i++) {
+        const auto &m = materials[i];
+        if (m.discrAttribute == SegmentedVolumeMaterial::DISCR_NONE || (!label_ranges && !discriminatesLabel(m))
+            || m.discrInterval[1] < static_cast<float>(first_label) || m.discrInterval[1] < m.discrInterval[0])
+            continue;
+        const Interval range = {std::max(static_cast<uint32_t>(std::max(m.discrInterval[0], 0.f)), first_label),
+                                static_cast<uint32_t>(m.discrInterval[1])};
+        if (i < selection.size() && selection[i] && materialVisible(m))
+            std::ranges::copy(subtractIntervals(range, claimed), std::back_inserter(intervals));
+        claimed.push_back(range);
+        claimed = mergeIntervals(claimed);
+    }
+    return mergeIntervals(intervals);
+}
+
+/// @param selection flag of each material, only labels of visible materials with a set flag are collected
+/// @return the merged label intervals of all labels that belong to a selected visible material, i.e. runs of labels
+///         within the attribute table and the label intervals of label id materials beyond it
+inline std::vector<Interval> materialLabelIntervals(const std::vector<SegmentedVolumeMaterial> &materials,
+                                                    const std::vector<uint8_t> &label_materials,
+                                                    const std::vector<uint8_t> &selection) {
+    const auto selected = [&](const uint8_t id) {
+        return id < selection.size() && id < materials.size() && selection[id] && materialVisible(materials[id]);
+    };
+    std::vector<Interval> intervals;
+    for (size_t l = 0; l < label_materials.size();) {
+        if (!selected(label_materials[l])) {
+            l++;
+            continue;
+        }
+        const size_t start = l;
+        while (l < label_materials.size() && selected(label_materials[l]))
+            l++;
+        intervals.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(l - 1u)});
+    }
+    std::ranges::copy(materialLabelRanges(materials, selection, static_cast<uint32_t>(label_materials.size())),
+                      std::back_inserter(intervals));
+    return mergeIntervals(intervals);
+}
+
+/// @param material only collect labels of this material, -1 for labels of any material
+/// @return the merged label intervals of all labels that belong to the material if it is visible
+inline std::vector<Interval> materialLabelIntervals(const std::vector<SegmentedVolumeMaterial> &materials,
+                                                    const std::vector<uint8_t> &label_materials, const int material = -1) {
+    std::vector<uint8_t> selection(materials.size(), material < 0 ? 1u : 0u);
+    if (material >= 0 && static_cast<size_t>(material) < selection.size())
+        selection[material] = 1u;
+    return materialLabelIntervals(materials, label_materials, selection);
+}
+
+} // namespace vvv
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "intervals.hpp"
+#include "parallel.hpp"
+
+namespace vvv {
+
+/// Transfer function independent summary of the labels within each cubic brick of a volume. Each brick stores its
+/// label range and either the sorted set of its labels if there are only a few, or a 64 bit bloom filter of them.
+/// Testing all bricks against new visible intervals is cheap compared to classifying every voxel again.
+class LabelBrickSummary {
+  public:
+    static constexpr int MAX_SET_LABELS = 6;
+
+    struct Brick {
+        uint32_t min = UINT32_MAX;
+        uint32_t max = 0u;
+        uint32_t count = 0u;                    ///< number of distinct labels, larger than MAX_SET_LABELS if the set overflowed
+        uint32_t labels[MAX_SET_LABELS] = {};   ///< sorted distinct labels if count <= MAX_SET_LABELS
+        uint64_t bloom = 0u;                    ///< bloom filter of all labels if count > MAX_SET_LABELS
+    };
+
+    LabelBrickSummary() = default;
+
+    /// Summarizes all bricks in parallel.
+    template <typename T>
+    LabelBrickSummary(const T *labels, const int (&dim)[3], const int brick_size = 16, const unsigned thread_count = 0u)
+        : m_brick_size(brick_size) {
+        for (int a = 0; a < 3; a++) {
+            m_dim[a] = dim[a];
+            m_brick_count[a] = (dim[a] + brick_size - 1) / brick_size;
+        }
+        m_bricks.resize(brickCount());
+        parallel_for(m_bricks.size(), thread_count, [&](const size_t b, unsigned) {
+            Brick &brick = m_bricks[b];
+            const int bx = brickOrigin(b, 0), by = brickOrigin(b, 1), bz = brickOrigin(b, 2);
+            uint32_t last = 0u;
+            bool has_last = false;
+            for (int z = bz; z < std::min(bz + m_brick_size, m_dim[2]); z++) {
+                for (int y = by; y < std::min(by + m_brick_size, m_dim[1]); y++) {
+                    const T *row = labels + (static_cast<size_t>(z) * m_dim[1] + y) * m_dim[0];
+                    for (int x = bx; x < std::min(bx + m_brick_size, m_dim[0]); x++) {
+                        const auto l = static_cast<uint32_t>(row[x]);
+                        // neighboring voxels mostly share their label
+                        if (has_last && l == last)
+                            continue;
+                        insert(brick, l);
+                        last = l;
+                        has_last = true;
+                    }
+                }
+            }
+        });
+    }
+
+    [[nodiscard]] int brickSize() const { return m_brick_size; }
+    [[nodiscard]] size_t brickCount() const {
+        return static_cast<size_t>(m_brick_count[0]) * m_brick_count[1] * m_brick_count[2];
+    }
+    [[nodiscard]] size_t brickIndex(const int x, const int y, const int z) const {
+        return (static_cast<size_t>(z / m_brick_size) * m_brick_count[1] + y / m_brick_size) * m_brick_count[0]
+               + x / m_brick_size;
+    }
+    /// @return voxel index of the first voxel of brick b along axis a
+    [[nodiscard]] int brickOrigin(const size_t b, const int a) const {
+        if (a == 0)
+            return static_cast<int>(b % m_brick_count[0]) * m_brick_size;
+        if (a == 1)
+            return static_cast<int>((b / m_brick_count[0]) % m_brick_count[1]) * m_brick_size;
+        return static_cast<int>(b / (static_cast<size_t>(m_brick_count[0]) * m_brick_count[1])) * m_brick_size;
+    }
+    [[nodiscard]] const Brick &brick(const size_t b) const { return m_bricks[b]; }
+
+    /// @param merged sorted, non-overlapping visible intervals as returned by mergeIntervals
+    /// @return false if the brick is guaranteed to contain no visible label, true if it may contain one
+    [[nodiscard]] bool visible(const size_t b, const std::vector<Interval> &merged) const {
+        const Brick &brick = m_bricks[b];
+        if (brick.count == 0u)
+            return false;
+        if (brick.count <= MAX_SET_LABELS) {
+            for (uint32_t i = 0; i < brick.count; i++) {
+                if (intervalsContain(merged, brick.labels[i]))
+                    return true;
+            }
+            return false;
+        }
+
+        // test the labels of short intervals within the label range against the bloom filter
+        auto it = std::upper_bound(merged.begin(), merged.end(), brick.min, [](const uint32_t l, const Interval &i) {
+            return l < i.start;
+        });
+        if (it != merged.begin())
+            --it;
+        for (; it != merged.end() && it->start <= brick.max; ++it) {
+            const uint32_t start = std::max(it->start, brick.min), end = std::min(it->end, brick.max);
+            if (start > end)
+                continue;
+            if (end - start >= 64u)
+                return true;
+            for (uint32_t l = start;; l++) {
+                if ((brick.bloom & bloomBits(l)) == bloomBits(l))
+                    return true;
+                if (l == end)
+                    break;
+            }
+        }
+        return false;
+    }
+
+    /// @return a visibility flag for each brick that is false if the brick contains no visible label
+    [[nodiscard]] std::vector<uint8_t> classify(const std::vector<Interval> &merged, const unsigned thread_count = 0u) const {
+        std::vector<uint8_t> flags(m_bricks.size());
+        parallel_for_blocks(m_bricks.size(), 1u << 12, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+            for (size_t b = begin; b < end; b++)
+                flags[b] = visible(b, merged);
+        });
+        return flags;
+    }
+
+  private:
+    static uint64_t bloomBits(const uint32_t label) {
+        const uint32_t h = label * 2654435761u;
+        return (uint64_t{1} << (h >> 26)) | (uint64_t{1} << ((h >> 20) & 63u));
+    }
+
+    static void insert(Brick &brick, const uint32_t label) {
+        brick.min = std::min(brick.min, label);
+        brick.max = std::max(brick.max, label);
+        if (brick.count > MAX_SET_LABELS) {
+            brick.bloom |= bloomBits(label);
+            return;
+        }
+        uint32_t *const end = brick.labels + brick.count;
+        uint32_t *const pos = std::lower_bound(brick.labels, end, label);
+        if (pos != end && *pos == label)
+            return;
+        if (brick.count == MAX_SET_LABELS) {
+            // switch from the label set to the bloom filter
+            for (const uint32_t l : brick.labels)
+                brick.bloom |= bloomBits(l);
+            brick.bloom |= bloomBits(label);
+            brick.count++;
+            return;
+        }
+        std::copy_backward(pos, end, end + 1);
+        *pos = label;
+        brick.count++;
+    }
+
+    int m_dim[3] = {0, 0, 0};
+    int m_brick_count[3] = {0, 0, 0};
+    int m_brick_size = 16;
+    std::vector<Brick> m_bricks;
+};
+
+} // namespace vvv
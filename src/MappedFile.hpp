@@ -0,0 +1,57 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+
+namespace vvv {
+
+/// Private (copy-on-write) memory mapping of a complete file. Pages are read lazily on first access and writes never
+/// reach the file, so mapped data can be preprocessed in place.
+class MappedFile {
+  public:
+    /// @param shared map the file read-only and shared instead, so that all processes mapping it use the same
+    ///        physical pages. Writing to the data of a shared mapping is not allowed.
+    explicit MappedFile(const std::filesystem::path &path, const bool shared = false) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("could not open file " + path.string());
+        struct stat st = {};
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            close(fd);
+            throw std::runtime_error("could not map empty or unreadable file " + path.string());
+        }
+        m_size = static_cast<size_t>(st.st_size);
+        void *data = shared ? mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0)
+                            : mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("could not map file " + path.string());
+        m_data = static_cast<char *>(data);
+    }
+    ~MappedFile() { munmap(m_data, m_size); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    [[nodiscard]] char *data() const { return m_data; }
+    [[nodiscard]] size_t size() const { return m_size; }
+
+    /// Passes an access pattern hint (e.g. MADV_SEQUENTIAL, MADV_WILLNEED) for the given byte range to the kernel.
+    void advise(const size_t offset, const size_t bytes, const int advice) const {
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t begin = offset / page * page;
+        madvise(m_data + begin, offset + bytes - begin, advice);
+    }
+
+  private:
+    char *m_data = nullptr;
+    size_t m_size = 0u;
+};
+
+} // namespace vvv
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "LabelBrickSummary.hpp"
+#include "parallel.hpp"
+
+namespace vvv {
+
+/// Bit-packed occupancy of a label volume with an OR mip hierarchy for empty space skipping. Level 0 stores one bit
+/// per voxel that is set if the voxel label is visible. Each coarser level halves the resolution and sets a bit if
+/// any of its (up to) 2x2x2 children is occupied, until a single cell covers the whole volume.
+class OccupancyGrid {
+  public:
+    /// First occupied voxel along a ray.
+    struct Hit {
+        glm::ivec3 voxel;   ///< voxel index
+        float t;            ///< ray parameter at which the ray enters the voxel
+        int axis;           ///< axis of the voxel face through which the ray enters, -1 if it starts inside the voxel
+    };
+
+    OccupancyGrid() = default;
+
+    /// Classifies all voxels in parallel and builds the mip hierarchy.
+    /// @param visible callable with signature bool(uint32_t label)
+    /// @param bricks optional label summary of the volume, only the voxels and mip cells of visible bricks are built
+    /// @param brick_visible visibility flag of each brick as returned by LabelBrickSummary::classify
+    template <typename T, typename F>
+    OccupancyGrid(const T *labels, const int (&dim)[3], F &&visible, const unsigned thread_count = 0u,
+                  const LabelBrickSummary *bricks = nullptr, const std::vector<uint8_t> &brick_visible = {}) {
+        glm::ivec3 level_dim(dim[0], dim[1], dim[2]);
+        m_levels.push_back({level_dim, {}});
+        while (level_dim.x > 1 || level_dim.y > 1 || level_dim.z > 1) {
+            level_dim = (level_dim + 1) / 2;
+            m_levels.push_back({level_dim, {}});
+        }
+        for (auto &l : m_levels)
+            l.bits.assign((l.cells() + 63u) / 64u, 0u);
+
+        if (!bricks) {
+            // each worker writes complete 64 bit words, no synchronization required
+            const size_t voxels = m_levels[0].cells();
+            parallel_for_blocks(m_levels[0].bits.size(), 1u << 12, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+                for (size_t w = begin; w < end; w++) {
+                    uint64_t word = 0u;
+                    for (size_t i = w * 64u; i < std::min(voxels, w * 64u + 64u); i++)
+                        word |= static_cast<uint64_t>(visible(static_cast<uint32_t>(labels[i]))) << (i % 64u);
+                    m_levels[0].bits[w] = word;
+                }
+            });
+            for (size_t l = 1; l < m_levels.size(); l++)
+                buildLevel(l, thread_count);
+            return;
+        }
+
+        // cells of the finest levels do not straddle bricks: only the cells of visible bricks are built, all others
+        // stay empty. The remaining coarse levels are small and rebuilt completely.
+        std::vector<size_t> visible_bricks;
+        for (size_t b = 0; b < brick_visible.size(); b++) {
+            if (brick_visible[b])
+                visible_bricks.push_back(b);
+        }
+        const int brick_size = bricks->brickSize();
+        size_t brick_levels = 1;
+        while (brick_levels < m_levels.size() && brick_size % (1 << brick_levels) == 0)
+            brick_levels++;
+        for (size_t l = 0; l < brick_levels; l++) {
+            Level &level = m_levels[l];
+            parallel_for(visible_bricks.size(), thread_count, [&](const size_t i, unsigned) {
+                const size_t b = visible_bricks[i];
+                const glm::ivec3 origin(bricks->brickOrigin(b, 0), bricks->brickOrigin(b, 1), bricks->brickOrigin(b, 2));
+                const glm::ivec3 lo = origin >> static_cast<int>(l);
+                const glm::ivec3 hi = glm::min((origin + brick_size) >> static_cast<int>(l), level.dim);
+                for (int z = lo.z; z < hi.z; z++) {
+                    for (int y = lo.y; y < hi.y; y++) {
+                        const size_t row = (static_cast<size_t>(z) * level.dim.y + y) * level.dim.x;
+                        size_t w = (row + lo.x) / 64u;
+                        uint64_t word = 0u;
+                        for (int x = lo.x; x < hi.x; x++) {
+                            const size_t c = row + x;
+                            if (c / 64u != w) {
+                                orWord(level, w, word);
+                                w = c / 64u;
+                                word = 0u;
+                            }
+                            const bool occupied = l == 0 ? visible(static_cast<uint32_t>(labels[c]))
+                                                         : anyChild(l, {x, y, z});
+                            word |= static_cast<uint64_t>(occupied) << (c % 64u);
+                        }
+                        orWord(level, w, word);
+                    }
+                }
+            });
+        }
+        for (size_t l = brick_levels; l < m_levels.size(); l++)
+            buildLevel(l, thread_count);
+    }
+
+    /// @return the number of levels, level 0 is the full resolution and the last level a single cell
+    [[nodiscard]] int levels() const { return static_cast<int>(m_levels.size()); }
+    [[nodiscard]] glm::ivec3 dimensions(const int level = 0) const { return m_levels[level].dim; }
+    [[nodiscard]] bool occupied(const int level, const glm::ivec3 &cell) const { return m_levels[level].get(cell); }
+    [[nodiscard]] bool empty() const { return m_levels.empty() || !m_levels.back().bits[0]; }
+
+    /// @return the memory footprint of all levels in bytes
+    [[nodiscard]] size_t bytes() const {
+        size_t b = 0u;
+        for (const auto &l : m_levels)
+            b += l.bits.size() * sizeof(uint64_t);
+        return b;
+    }
+
+    /// Hierarchical DDA that finds the first occupied voxel along the ray within [t_enter, t_exit). Empty cells are
+    /// skipped on the coarsest level that is empty, so empty regions are crossed in O(log n) steps.
+    /// Voxel i covers the interval [i, i+1) along each axis.
+    /// @param voxel voxel that contains the ray at t_enter
+    /// @param enter_axis axis of the face through which the ray enters at t_enter, -1 if none
+    /// @return true if an occupied voxel was found
+    [[nodiscard]] bool firstHit(const glm::vec3 &origin, const glm::vec3 &dir, float t_enter, const float t_exit,
+                                glm::ivec3 voxel, int enter_axis, Hit &hit) const {
+        if (empty())
+            return false;
+        const glm::ivec3 step(dir.x >= 0.f ? 1 : -1, dir.y >= 0.f ? 1 : -1, dir.z >= 0.f ? 1 : -1);
+        const glm::vec3 inv_dir = 1.f / dir;
+        const int top = levels() - 1;
+        int level = top;
+        float t = t_enter;
+        while (t < t_exit) {
+            if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(voxel, m_levels[0].dim)))
+                return false;
+            const glm::ivec3 cell = voxel >> level;
+            if (occupied(level, cell)) {
+                if (level == 0) {
+                    hit = {voxel, t, enter_axis};
+                    return true;
+                }
+                level--;
+                continue;
+            }
+
+            // leave the empty cell through its nearest face
+            const glm::ivec3 lo = cell << level, hi = (cell + 1) << level;
+            float t_next = INFINITY;
+            int axis = 0;
+            for (int a = 0; a < 3; a++) {
+                if (dir[a] == 0.f)
+                    continue;
+                const float t_face = (static_cast<float>(step[a] > 0 ? hi[a] : lo[a]) - origin[a]) * inv_dir[a];
+                if (t_face < t_next) {
+                    t_next = t_face;
+                    axis = a;
+                }
+            }
+            const glm::vec3 p = origin + t_next * dir;
+            for (int a = 0; a < 3; a++)
+                voxel[a] = a == axis ? (step[a] > 0 ? hi[a] : lo[a] - 1)
+                                     : glm::clamp(static_cast<int>(std::floor(p[a])), lo[a], hi[a] - 1);
+            t = std::max(t, t_next);
+            enter_axis = axis;
+            level = std::min(level + 1, top);
+        }
+        return false;
+    }
+
+    /// Rays that traverse the grid in lockstep, stored as a structure of arrays with one lane per ray.
+    template <int N>
+    struct RayPacket {
+        float origin[3][N];
+        float dir[3][N];
+        float t[N];             ///< ray parameter at which the lane enters its current voxel
+        float t_exit[N];
+        int voxel[3][N];        ///< voxel that contains the lane at t, the hit voxel once the lane hit
+        int enter_axis[N];
+        uint8_t active[N];      ///< lanes that are still traversing, must be set for all lanes with a valid ray
+        uint8_t hit[N];         ///< lanes that found an occupied voxel
+    };
+
+    /// Hierarchical DDA as in firstHit() for a packet of rays. Each iteration first looks up the occupancy of the
+    /// current cell of all active lanes, where lanes on occupied cells descend a level or report their hit. These
+    /// lookups depend on the data and stay scalar. Then all lanes in empty cells leave them through their nearest face
+    /// in one explicit SIMD step over the N lanes (GCC / Clang vector extensions, a scalar loop otherwise).
+    /// Lanes without a valid ray must have active = 0.
+    template <int N>
+    void firstHits(RayPacket<N> &packet) const {
+        static_assert(N > 0 && (N & (N - 1)) == 0, "packet size must be a power of two");
+        int32_t level[N];
+        int32_t advance[N];         ///< -1 for lanes that leave their empty cell, 0 otherwise
+        float inv_dir[3][N];
+        const int top = levels() - 1;
+        for (int l = 0; l < N; l++) {
+            packet.hit[l] = 0u;
+            if (!packet.active[l] || empty()) {
+                // keep the arithmetic of unused lanes finite
+                packet.active[l] = 0u;
+                for (int a = 0; a < 3; a++) {
+                    packet.origin[a][l] = 0.f;
+                    packet.dir[a][l] = 1.f;
+                    packet.voxel[a][l] = 0;
+                }
+                packet.t[l] = 0.f;
+            }
+            level[l] = top;
+            for (int a = 0; a < 3; a++)
+                inv_dir[a][l] = 1.f / packet.dir[a][l];
+        }
+
+        const glm::ivec3 dim = m_levels[0].dim;
+        for (;;) {
+            bool any_active = false;
+            for (int l = 0; l < N; l++) {
+                advance[l] = 0;
+                if (!packet.active[l])
+                    continue;
+                const glm::ivec3 voxel(packet.voxel[0][l], packet.voxel[1][l], packet.voxel[2][l]);
+                if (!(packet.t[l] < packet.t_exit[l]) || glm::any(glm::lessThan(voxel, glm::ivec3(0)))
+                    || glm::any(glm::greaterThanEqual(voxel, dim))) {
+                    packet.active[l] = 0u;
+                    continue;
+                }
+                any_active = true;
+                if (!occupied(level[l], voxel >> level[l])) {
+                    advance[l] = -1;
+                } else if (level[l] == 0) {
+                    packet.hit[l] = 1u;
+                    packet.active[l] = 0u;
+                } else {
+                    level[l]--;
+                }
+            }
+            if (!any_active)
+                return;
+
+            advanceLanes(packet, level, advance, inv_dir, top);
+        }
+    }
+
+  private:
+#if defined(__GNUC__) || defined(__clang__)
+    /// four lanes of a packet, SSE2 on x86-64 and NEON on ARM
+    typedef float vfloat4 __attribute__((vector_size(16)));
+    typedef int32_t vint4 __attribute__((vector_size(16)));
+
+    /// lane-wise mask ? a : b for masks of all ones or all zeros, as returned by vector comparisons
+    static vint4 select(const vint4 mask, const vint4 a, const vint4 b) { return (mask & a) | (~mask & b); }
+    static vfloat4 select(const vint4 mask, const vfloat4 a, const vfloat4 b) {
+        return std::bit_cast<vfloat4>(select(mask, std::bit_cast<vint4>(a), std::bit_cast<vint4>(b)));
+    }
+    template <typename V>
+    static V load4(const void *src) {
+        V v;
+        std::memcpy(&v, src, sizeof(V));
+        return v;
+    }
+
+    /// Moves all lanes with advance = -1 to the neighbor of their empty cell on level[l] through its nearest face and
+    /// ascends one level, with one vector operation per step for four lanes at a time.
+    template <int N>
+    static void advanceLanes(RayPacket<N> &packet, int32_t (&level)[N], const int32_t (&advance)[N],
+                             const float (&inv_dir)[3][N], const int top) {
+        static_assert(N % 4 == 0, "SIMD packets consist of groups of four lanes");
+        for (int g = 0; g < N; g += 4) {
+            vint4 lv = load4<vint4>(level + g);
+            const vint4 adv = load4<vint4>(advance + g);
+            vfloat4 t = load4<vfloat4>(packet.t + g);
+            vint4 voxel[3], lo[3], hi[3], positive[3];
+            vfloat4 origin[3], dir[3];
+            vint4 axis = vint4{};
+            vfloat4 t_next = vfloat4{} + INFINITY;
+            for (int a = 0; a < 3; a++) {
+                voxel[a] = load4<vint4>(packet.voxel[a] + g);
+                origin[a] = load4<vfloat4>(packet.origin[a] + g);
+                dir[a] = load4<vfloat4>(packet.dir[a] + g);
+                lo[a] = (voxel[a] >> lv) << lv;
+                hi[a] = lo[a] + (1 << lv);
+                positive[a] = dir[a] >= 0.f;
+                const vfloat4 face = __builtin_convertvector(select(positive[a], hi[a], lo[a]), vfloat4);
+                const vfloat4 t_face = select(dir[a] == 0.f, vfloat4{} + INFINITY,
+                                              (face - origin[a]) * load4<vfloat4>(inv_dir[a] + g));
+                const vint4 closer = t_face < t_next;
+                axis = select(closer, vint4{} + a, axis);
+                t_next = select(closer, t_face, t_next);
+            }
+            for (int a = 0; a < 3; a++) {
+                const vfloat4 p = origin[a] + t_next * dir[a];
+                // floor: truncation rounds negative fractions up, adding the comparison mask of -1 corrects them
+                vint4 inside = __builtin_convertvector(p, vint4);
+                inside += __builtin_convertvector(inside, vfloat4) > p;
+                inside = select(inside < lo[a], lo[a], inside);
+                inside = select(inside > hi[a] - 1, hi[a] - 1, inside);
+                const vint4 crossed = select(positive[a], hi[a], lo[a] - 1);
+                const vint4 v = select(adv, select(axis == a, crossed, inside), voxel[a]);
+                std::memcpy(packet.voxel[a] + g, &v, sizeof(v));
+            }
+            t = select(adv, select(t_next > t, t_next, t), t);
+            const vint4 enter_axis = select(adv, axis, load4<vint4>(packet.enter_axis + g));
+            const vint4 up = lv + 1;
+            lv = select(adv, select(up > top, vint4{} + top, up), lv);
+            std::memcpy(packet.t + g, &t, sizeof(t));
+            std::memcpy(packet.enter_axis + g, &enter_axis, sizeof(enter_axis));
+            std::memcpy(level + g, &lv, sizeof(lv));
+        }
+    }
+#else
+    /// Moves all lanes with advance = -1 to the neighbor of their empty cell on level[l] through its nearest face and
+    /// ascends one level.
+    template <int N>
+    static void advanceLanes(RayPacket<N> &packet, int32_t (&level)[N], const int32_t (&advance)[N],
+                             const float (&inv_dir)[3][N], const int top) {
+        for (int l = 0; l < N; l++) {
+            const int lv = level[l];
+            int lo[3], hi[3];
+            float t_next = INFINITY;
+            int axis = 0;
+            for (int a = 0; a < 3; a++) {
+                lo[a] = (packet.voxel[a][l] >> lv) << lv;
+                hi[a] = lo[a] + (1 << lv);
+                const float face = static_cast<float>(packet.dir[a][l] >= 0.f ? hi[a] : lo[a]);
+                const float t_face = packet.dir[a][l] == 0.f ? INFINITY : (face - packet.origin[a][l]) * inv_dir[a][l];
+                axis = t_face < t_next ? a : axis;
+                t_next = std::min(t_face, t_next);
+            }
+            for (int a = 0; a < 3; a++) {
+                const float p = packet.origin[a][l] + t_next * packet.dir[a][l];
+                const int inside = glm::clamp(static_cast<int>(std::floor(p)), lo[a], hi[a] - 1);
+                const int crossed = packet.dir[a][l] >= 0.f ? hi[a] : lo[a] - 1;
+                packet.voxel[a][l] = advance[l] ? (a == axis ? crossed : inside) : packet.voxel[a][l];
+            }
+            packet.t[l] = advance[l] ? std::max(packet.t[l], t_next) : packet.t[l];
+            packet.enter_axis[l] = advance[l] ? axis : packet.enter_axis[l];
+            level[l] = advance[l] ? std::min(lv + 1, top) : lv;
+        }
+    }
+#endif
+
+    struct Level {
+        glm::ivec3 dim;
+        std::vector<uint64_t> bits;
+
+        [[nodiscard]] size_t cells() const {
+            return static_cast<size_t>(dim.x) * static_cast<size_t>(dim.y) * static_cast<size_t>(dim.z);
+        }
+        [[nodiscard]] glm::ivec3 cell(const size_t i) const {
+            return {static_cast<int>(i % dim.x), static_cast<int>((i / dim.x) % dim.y),
+                    static_cast<int>(i / (static_cast<size_t>(dim.x) * dim.y))};
+        }
+        [[nodiscard]] bool get(const glm::ivec3 &c) const {
+            const size_t i = (static_cast<size_t>(c.z) * dim.y + c.y) * dim.x + c.x;
+            return (bits[i / 64u] >> (i % 64u)) & 1u;
+        }
+    };
+
+    /// @return true if any of the (up to) 2x2x2 children of cell c on level l > 0 is occupied
+    [[nodiscard]] bool anyChild(const size_t l, const glm::ivec3 &c) const {
+        const Level &fine = m_levels[l - 1];
+        for (int z = 2 * c.z; z < std::min(2 * c.z + 2, fine.dim.z); z++)
+            for (int y = 2 * c.y; y < std::min(2 * c.y + 2, fine.dim.y); y++)
+                for (int x = 2 * c.x; x < std::min(2 * c.x + 2, fine.dim.x); x++)
+                    if (fine.get({x, y, z}))
+                        return true;
+        return false;
+    }
+
+    /// Rebuilds all cells of level l > 0 from level l - 1.
+    void buildLevel(const size_t l, const unsigned thread_count) {
+        Level &coarse = m_levels[l];
+        parallel_for_blocks(coarse.bits.size(), 1u << 10, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+            for (size_t w = begin; w < end; w++) {
+                uint64_t word = 0u;
+                for (size_t i = w * 64u; i < std::min(coarse.cells(), w * 64u + 64u); i++)
+                    word |= static_cast<uint64_t>(anyChild(l, coarse.cell(i))) << (i % 64u);
+                coarse.bits[w] = word;
+            }
+        });
+    }
+
+    /// Sets the bits of word w. Neighboring bricks can share a word at their boundary.
+    static void orWord(Level &level, const size_t w, const uint64_t word) {
+        if (word)
+            std::atomic_ref<uint64_t>(level.bits[w]).fetch_or(word, std::memory_order_relaxed);
+    }
+
+    std::vector<Level> m_levels;
+};
+
+} // namespace vvv
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace vvv {
+
+/// Flat JSON object of a single render request. Values are strings, numbers, booleans or arrays of numbers, nested
+/// objects are not supported.
+class JsonRequest {
+  public:
+    /// Parses a JSON object from a single line.
+    /// @throws std::runtime_error if the line is not a flat JSON object
+    explicit JsonRequest(const std::string &line) : m_text(line) {
+        skipSpace();
+        expect('{');
+        skipSpace();
+        if (peek() == '}') {
+            m_pos++;
+            return;
+        }
+        while (true) {
+            skipSpace();
+            const std::string key = parseString();
+            skipSpace();
+            expect(':');
+            skipSpace();
+            Value value;
+            if (peek() == '"') {
+                value.string = parseString();
+                value.is_string = true;
+            } else if (peek() == '[') {
+                m_pos++;
+                skipSpace();
+                if (peek() != ']') {
+                    while (true) {
+                        skipSpace();
+                        value.numbers.push_back(parseNumber());
+                        skipSpace();
+                        if (peek() != ',')
+                            break;
+                        m_pos++;
+                    }
+                }
+                expect(']');
+            } else if (m_text.compare(m_pos, 4, "true") == 0 || m_text.compare(m_pos, 5, "false") == 0) {
+                value.numbers.push_back(m_text[m_pos] == 't' ? 1. : 0.);
+                m_pos += m_text[m_pos] == 't' ? 4u : 5u;
+            } else {
+                value.numbers.push_back(parseNumber());
+            }
+            m_values[key] = std::move(value);
+            skipSpace();
+            if (peek() == ',') {
+                m_pos++;
+                continue;
+            }
+            expect('}');
+            break;
+        }
+    }
+
+    [[nodiscard]] bool has(const std::string &key) const { return m_values.contains(key); }
+
+    [[nodiscard]] std::string string(const std::string &key, const std::string &fallback = {}) const {
+        const auto it = m_values.find(key);
+        if (it == m_values.end())
+            return fallback;
+        if (!it->second.is_string)
+            throw std::runtime_error("\"" + key + "\" must be a string");
+        return it->second.string;
+    }
+
+    [[nodiscard]] double number(const std::string &key, const double fallback = 0.) const {
+        const auto it = m_values.find(key);
+        if (it == m_values.end())
+            return fallback;
+        if (it->second.is_string || it->second.numbers.size() != 1u)
+            throw std::runtime_error("\"" + key + "\" must be a number");
+        return it->second.numbers[0];
+    }
+
+    /// @return the array of the key which must have exactly count numbers
+    [[nodiscard]] std::vector<double> numbers(const std::string &key, const size_t count) const {
+        const auto it = m_values.find(key);
+        if (it == m_values.end() || it->second.is_string || it->second.numbers.size() != count)
+            throw std::runtime_error("\"" + key + "\" must be an array of " + std::to_string(count) + " numbers");
+        return it->second.numbers;
+    }
+
+    /// @return all numbers of the key, a single number is returned as an array of one number
+    [[nodiscard]] std::vector<double> numberList(const std::string &key) const {
+        const auto it = m_values.find(key);
+        if (it == m_values.end() || it->second.is_string)
+            throw std::runtime_error("\"" + key + "\" must be an array of numbers");
+        return it->second.numbers;
+    }
+
+    /// @return the keys of all values in the request
+    [[nodiscard]] std::vector<std::string> keys() const {
+        std::vector<std::string> k;
+        for (const auto &[key, value] : m_values)
+            k.push_back(key);
+        return k;
+    }
+
+  private:
+    struct Value {
+        bool is_string = false;
+        std::string string;
+        std::vector<double> numbers;
+    };
+
+    [[nodiscard]] char peek() const {
+        if (m_pos >= m_text.size())
+            throw std::runtime_error("unexpected end of request");
+        return m_text[m_pos];
+    }
+    void skipSpace() {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos])))
+            m_pos++;
+    }
+    void expect(const char c) {
+        if (peek() != c)
+            throw std::runtime_error(std::string("expected '") + c + "' at position " + std::to_string(m_pos));
+        m_pos++;
+    }
+    std::string parseString() {
+        expect('"');
+        std::string s;
+        while (peek() != '"') {
+            if (m_text[m_pos] == '\\') {
+                m_pos++;
+                const char e = peek();
+                s += e == 'n' ? '\n' : e == 't' ? '\t' : e;
+            } else {
+                s += m_text[m_pos];
+            }
+            m_pos++;
+        }
+        m_pos++;
+        return s;
+    }
+    double parseNumber() {
+        const char *begin = m_text.c_str() + m_pos;
+        char *end;
+        const double v = std::strtod(begin, &end);
+        if (end == begin)
+            throw std::runtime_error("expected a number at position " + std::to_string(m_pos));
+        m_pos += end - begin;
+        return v;
+    }
+
+    std::string m_text;
+    size_t m_pos = 0u;
+    std::map<std::string, Value> m_values;
+};
+
+/// @return the string as a quoted JSON string
+inline std::string jsonString(const std::string &s) {
+    std::string quoted = "\"";
+    for (const char c : s) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (c == '\n') {
+            quoted += "\\n";
+        } else if (static_cast<unsigned char>(c) < 0x20u) {
+            // all other control characters must be escaped as well
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+/// Line based request loop of a persistent render process. Each request is a single line of JSON that is answered by
+/// a single line of JSON. Requests are read from a Unix domain socket that accepts one client after another, or from
+/// stdin with answers on stdout. A request {"command": "shutdown"} stops the server. Clients that disconnect early
+/// do not raise SIGPIPE. The server is bound to the volume the process was started with, a client that needs another
+/// data set starts another server.
+class RenderServer {
+  public:
+    /// Handles a request and returns the answer. Exceptions are answered with an error status.
+    using Handler = std::function<std::string(const JsonRequest &request)>;
+
+    /// @param socket_path path of the Unix domain socket, "-" to read requests from stdin
+    /// @param answers buffer that receives the answers to stdin requests, the original stdout buffer if std::cout is
+    ///                redirected to keep logs out of the answers
+    explicit RenderServer(std::string socket_path, std::streambuf *answers = std::cout.rdbuf())
+        : m_socket_path(std::move(socket_path)), m_answers(answers) {}
+
+    void serve(const Handler &handler) {
+        if (m_socket_path == "-") {
+            std::string line;
+            while (!m_shutdown && std::getline(std::cin, line))
+                m_answers << answer(handler, line) << std::endl;
+            return;
+        }
+
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (m_socket_path.size() >= sizeof(address.sun_path))
+            throw std::runtime_error("socket path " + m_socket_path + " is too long");
+        std::strncpy(address.sun_path, m_socket_path.c_str(), sizeof(address.sun_path) - 1u);
+
+        const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0)
+            throw std::runtime_error("could not create socket: " + std::string(std::strerror(errno)));
+        unlink(m_socket_path.c_str());
+        if (bind(server, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0 || listen(server, 4) < 0) {
+            const std::string error = std::strerror(errno);
+            close(server);
+            throw std::runtime_error("could not listen on " + m_socket_path + ": " + error);
+        }
+        std::cout << "Serving render requests on " << m_socket_path << std::endl;
+
+        while (!m_shutdown) {
+            const int client = accept(server, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR)
+                    continue;
+                std::cerr << "Could not accept a client on " << m_socket_path << ": " << std::strerror(errno)
+                          << ", stopping the server" << std::endl;
+                break;
+            }
+            std::string buffer;
+            char chunk[4096];
+            ssize_t received;
+            bool connected = true;
+            while (connected && !m_shutdown && (received = read(client, chunk, sizeof(chunk))) > 0) {
+                buffer.append(chunk, static_cast<size_t>(received));
+                for (size_t newline = buffer.find('\n'); newline != std::string::npos; newline = buffer.find('\n')) {
+                    const std::string response = answer(handler, buffer.substr(0, newline)) + "\n";
+                    buffer.erase(0, newline + 1u);
+                    connected = writeAll(client, response);
+                    if (!connected || m_shutdown)
+                        break;
+                }
+            }
+            close(client);
+        }
+        close(server);
+        unlink(m_socket_path.c_str());
+    }
+
+  private:
+    std::string answer(const Handler &handler, const std::string &line) {
+        try {
+            const JsonRequest request(line);
+            if (request.string("command") == "shutdown") {
+                m_shutdown = true;
+                return R"({"status":"ok"})";
+            }
+            return handler(request);
+        } catch (const std::exception &e) {
+            return R"({"status":"error","message":)" + jsonString(e.what()) + "}";
+        }
+    }
+
+    static bool writeAll(const int fd, const std::string &data) {
+        size_t written = 0u;
+        while (written < data.size()) {
+            // a client that closed its end fails with EPIPE instead of killing the process with SIGPIPE
+            const ssize_t w = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+            if (w < 0 && errno == EINTR)
+                continue;
+            if (w <= 0)
+                return false;
+            written += static_cast<size_t>(w);
+        }
+        return true;
+    }
+
+    std::string m_socket_path;
+    std::ostream m_answers;
+    bool m_shutdown = false;
+};
+
+} // namespace vvv
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <sys/mman.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "intervals.hpp"
+#include "label_remap.hpp"
+#include "MappedFile.hpp"
+#include "parallel.hpp"
+#include "util.hpp"
+
+namespace vvv {
+
+/// @return a 64 bit checksum of the bytes. The bytes are hashed in parallel 1 MiB blocks whose hashes are combined in
+///         order, so the result does not depend on the thread count.
+inline uint64_t payloadChecksum(const void *data, const size_t bytes, const unsigned thread_count = 0u) {
+    constexpr size_t BLOCK_SIZE = size_t{1} << 20;
+    std::vector<uint64_t> block_hashes((bytes + BLOCK_SIZE - 1u) / BLOCK_SIZE);
+    parallel_for_blocks(bytes, BLOCK_SIZE, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+        const auto *b = static_cast<const unsigned char *>(data);
+        uint64_t h = 0x9E3779B97F4A7C15ull ^ (end - begin);
+        size_t i = begin;
+        for (; i + 8u <= end; i += 8u) {
+            uint64_t word;
+            std::memcpy(&word, b + i, sizeof(word));
+            h = (h ^ word) * 0xFF51AFD7ED558CCDull;
+            h ^= h >> 32;
+        }
+        for (; i < end; i++)
+            h = (h ^ b[i]) * 1099511628211ull;
+        block_hashes[begin / BLOCK_SIZE] = h;
+    });
+    // FNV-1a over the block hashes
+    uint64_t h = 14695981039346656037ull;
+    for (const uint64_t block : block_hashes)
+        h = (h ^ block) * 1099511628211ull;
+    return h;
+}
+
+/// Pipeline state that belongs to a preprocessed volume and must be restored together with its labels.
+struct PreprocessedVolumeState {
+    double volume_bounds[6] = {};       ///< world space bounds of the complete volume
+    double visible_bounds[6] = {};      ///< world space bounds of the rendered voxels
+    uint32_t label_min = UINT32_MAX;
+    uint32_t label_max = 0u;
+    int lod_level = 0;
+    std::vector<Interval> intervals;    ///< merged transfer function intervals, possibly tightened to occurring labels
+    std::vector<Interval> visible_intervals;
+    LabelRemap label_remap;
+};
+
+/// Header in the first page of a shared volume segment. The segment is laid out as
+/// [header page | label payload (page aligned) | intervals | visible intervals | dense to original labels].
+struct SharedVolumeHeader {
+    static constexpr char MAGIC[8] = {'V', 'V', 'V', 'S', 'H', 'V', 'O', 'L'};
+    static constexpr uint32_t VERSION = 1u;
+    static constexpr size_t ALIGNMENT = 4096u;
+
+    char magic[8];
+    uint32_t version;
+    int32_t vtk_type;                   ///< VTK scalar type of the labels
+    uint64_t key;                       ///< hash of the source volume and all preprocessing parameters
+    // image geometry
+    int32_t dimensions[3];
+    int32_t lod_level;
+    double spacing[3];
+    double origin[3];
+    double volume_bounds[6];
+    double visible_bounds[6];
+    // labels
+    uint32_t label_min;
+    uint32_t label_max;
+    uint32_t remap_visible_count;
+    uint32_t remap_labels;              ///< number of dense labels, 0 if the labels are not remapped
+    uint64_t interval_count;
+    uint64_t visible_interval_count;
+    // payload
+    uint64_t payload_offset;
+    uint64_t payload_bytes;
+    uint64_t payload_checksum;          ///< payloadChecksum of the labels
+    uint64_t table_offset;              ///< offset of the interval and remap tables after the payload
+
+    [[nodiscard]] uint64_t tableBytes() const {
+        return (interval_count + visible_interval_count) * sizeof(Interval) + uint64_t{remap_labels} * sizeof(uint32_t);
+    }
+};
+static_assert(sizeof(SharedVolumeHeader) <= SharedVolumeHeader::ALIGNMENT);
+
+/// Read-only shared mapping of a published volume segment. All processes attached to the same segment share the
+/// physical pages of its labels. Must outlive all images created from it.
+class SharedVolume {
+  public:
+    explicit SharedVolume(const std::filesystem::path &path) : m_path(path), m_file(path, true) {}
+
+    [[nodiscard]] const SharedVolumeHeader &header() const { return *reinterpret_cast<const SharedVolumeHeader *>(m_file.data()); }
+    [[nodiscard]] const void *labels() const { return m_file.data() + header().payload_offset; }
+    [[nodiscard]] const std::filesystem::path &path() const { return m_path; }
+
+    /// @return true if the segment is large enough for the header and all sections it references
+    [[nodiscard]] bool complete() const {
+        if (m_file.size() < SharedVolumeHeader::ALIGNMENT)
+            return false;
+        const SharedVolumeHeader &h = header();
+        return std::memcmp(h.magic, SharedVolumeHeader::MAGIC, sizeof(h.magic)) == 0 && h.version == SharedVolumeHeader::VERSION
+               && h.payload_offset + h.payload_bytes <= h.table_offset && h.table_offset + h.tableBytes() <= m_file.size();
+    }
+
+    /// @return true if the checksum of the labels matches the one computed when the segment was published
+    [[nodiscard]] bool verify(const unsigned thread_count = 0u) const {
+        return payloadChecksum(labels(), header().payload_bytes, thread_count) == header().payload_checksum;
+    }
+
+    [[nodiscard]] PreprocessedVolumeState state() const {
+        const SharedVolumeHeader &h = header();
+        PreprocessedVolumeState state;
+        std::copy_n(h.volume_bounds, 6, state.volume_bounds);
+        std::copy_n(h.visible_bounds, 6, state.visible_bounds);
+        state.label_min = h.label_min;
+        state.label_max = h.label_max;
+        state.lod_level = h.lod_level;
+        const char *table = m_file.data() + h.table_offset;
+        const auto *intervals = reinterpret_cast<const Interval *>(table);
+        state.intervals.assign(intervals, intervals + h.interval_count);
+        state.visible_intervals.assign(intervals + h.interval_count, intervals + h.interval_count + h.visible_interval_count);
+        const auto *dense_to_label = reinterpret_cast<const uint32_t *>(intervals + h.interval_count + h.visible_interval_count);
+        state.label_remap.dense_to_label.assign(dense_to_label, dense_to_label + h.remap_labels);
+        state.label_remap.visible_count = h.remap_visible_count;
+        return state;
+    }
+
+    /// @return an image that uses the shared labels as its read-only scalars without copying them
+    [[nodiscard]] vtkSmartPointer<vtkImageData> createImage() const {
+        const SharedVolumeHeader &h = header();
+        auto image = vtkSmartPointer<vtkImageData>::New();
+        image->SetDimensions(h.dimensions[0], h.dimensions[1], h.dimensions[2]);
+        image->SetSpacing(h.spacing[0], h.spacing[1], h.spacing[2]);
+        image->SetOrigin(h.origin[0], h.origin[1], h.origin[2]);
+        setExternalLabelScalars(image, h.vtk_type, const_cast<void *>(labels()));
+        return image;
+    }
+
+  private:
+    std::filesystem::path m_path;
+    MappedFile m_file;
+};
+
+/// Directory of preprocessed volumes that concurrent render processes attach to instead of importing the volume
+/// themselves. The default /dev/shm holds POSIX shared memory, a hugetlbfs mount backs the labels with huge pages.
+/// Segments are keyed by the source volume and all parameters of the preprocessing and stay until they are deleted.
+class SharedVolumeStore {
+  public:
+    explicit SharedVolumeStore(std::filesystem::path directory) : m_directory(std::move(directory)) {}
+
+    /// @param source_hash hash of the source volume, e.g. VolumeCacheKey::hash()
+    /// @param preprocessing serialized parameters of all preprocessing steps that change the labels or state
+    /// @return the key of the preprocessed volume
+    [[nodiscard]] static uint64_t key(const uint64_t source_hash, const std::string &preprocessing) {
+        // FNV-1a
+        uint64_t h = 14695981039346656037ull;
+        for (int i = 0; i < 8; i++)
+            h = (h ^ ((source_hash >> (8 * i)) & 0xFFu)) * 1099511628211ull;
+        for (const char c : preprocessing)
+            h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        return h;
+    }
+
+    [[nodiscard]] std::filesystem::path file(const uint64_t key) const {
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(key));
+        return m_directory / (std::string("vtk-segvol-") + hash + ".vvvshm");
+    }
+
+    /// Maps the segment of the given key read-only. Segments are only renamed into place once they are complete, so
+    /// the labels are not read here unless verify_labels is set.
+    /// @param verify_labels checksum the labels, which reads the whole payload in every attaching process
+    /// @return the attached segment or nullptr if no valid segment exists for the key
+    [[nodiscard]] std::unique_ptr<SharedVolume> attach(const uint64_t key, const bool verify_labels = false,
+                                                       const unsigned thread_count = 0u) const {
+        const std::filesystem::path path = file(key);
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(path, ec))
+            return nullptr;
+        std::unique_ptr<SharedVolume> volume;
+        try {
+            volume = std::make_unique<SharedVolume>(path);
+        } catch (const std::runtime_error &) {
+            return nullptr;
+        }
+        if (!volume->complete() || volume->header().key != key || (verify_labels && !volume->verify(thread_count)))
+            return nullptr;
+        return volume;
+    }
+
+    /// Publishes the preprocessed image and its pipeline state as segment of the given key. The segment is written
+    /// through a shared mapping of a temporary file that is renamed afterward, so concurrent processes never attach
+    /// to partial segments and processes attached to a replaced segment keep their mapping. The segment memory is
+    /// reserved before it is mapped, so a full shared memory directory fails here instead of raising SIGBUS on write.
+    /// @return true if the segment was published successfully, the caller keeps its private image otherwise
+    bool publish(const uint64_t key, vtkImageData *image, const PreprocessedVolumeState &state,
+                 const unsigned thread_count = 0u) const {
+        SharedVolumeHeader h = {};
+        std::memcpy(h.magic, SharedVolumeHeader::MAGIC, sizeof(h.magic));
+        h.version = SharedVolumeHeader::VERSION;
+        h.vtk_type = image->GetScalarType();
+        h.key = key;
+        image->GetDimensions(h.dimensions);
+        h.lod_level = state.lod_level;
+        image->GetSpacing(h.spacing);
+        image->GetOrigin(h.origin);
+        std::copy_n(state.volume_bounds, 6, h.volume_bounds);
+        std::copy_n(state.visible_bounds, 6, h.visible_bounds);
+        h.label_min = state.label_min;
+        h.label_max = state.label_max;
+        h.remap_visible_count = state.label_remap.visible_count;
+        h.remap_labels = state.label_remap.label_count();
+        h.interval_count = state.intervals.size();
+        h.visible_interval_count = state.visible_intervals.size();
+        h.payload_offset = SharedVolumeHeader::ALIGNMENT;
+        h.payload_bytes = static_cast<uint64_t>(image->GetNumberOfPoints()) * static_cast<uint64_t>(image->GetScalarSize());
+        h.table_offset = (h.payload_offset + h.payload_bytes + 7u) & ~uint64_t{7u};
+
+        const std::filesystem::path path = file(key);
+        const std::filesystem::path tmp_path = path.string() + ".tmp" + std::to_string(getpid());
+        std::error_code ec;
+        std::filesystem::create_directories(m_directory, ec);
+        const int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        // hugetlbfs only accepts sizes in multiples of its huge page size, which it reports as block size
+        struct statfs fs = {};
+        const uint64_t block = fstatfs(fd, &fs) == 0 && fs.f_bsize > 0 ? static_cast<uint64_t>(fs.f_bsize) : SharedVolumeHeader::ALIGNMENT;
+        const uint64_t size = (h.table_offset + h.tableBytes() + block - 1u) / block * block;
+        // ftruncate only creates a sparse file: reserve all pages, posix_fallocate would emulate this with writes
+        // that hugetlbfs does not support
+        const bool reserved = fs.f_type == HUGETLBFS_MAGIC ? fallocate(fd, 0, 0, static_cast<off_t>(size)) == 0
+                                                           : posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0;
+        void *mapping = reserved ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            std::filesystem::remove(tmp_path, ec);
+            return false;
+        }
+
+        auto *segment = static_cast<char *>(mapping);
+        const auto *labels = static_cast<const char *>(image->GetScalarPointer());
+        parallel_for_blocks(h.payload_bytes, size_t{1} << 22, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+            std::memcpy(segment + h.payload_offset + begin, labels + begin, end - begin);
+        });
+        h.payload_checksum = payloadChecksum(segment + h.payload_offset, h.payload_bytes, thread_count);
+        auto *table = reinterpret_cast<Interval *>(segment + h.table_offset);
+        std::copy(state.intervals.begin(), state.intervals.end(), table);
+        std::copy(state.visible_intervals.begin(), state.visible_intervals.end(), table + h.interval_count);
+        std::copy(state.label_remap.dense_to_label.begin(), state.label_remap.dense_to_label.end(),
+                  reinterpret_cast<uint32_t *>(table + h.interval_count + h.visible_interval_count));
+        std::memcpy(segment, &h, sizeof(h));
+        munmap(mapping, size);
+
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec) {
+            std::filesystem::remove(tmp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    std::filesystem::path m_directory;
+};
+
+} // namespace vvv
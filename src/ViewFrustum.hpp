@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "VoxelRegion.hpp"
+
+namespace vvv {
+
+/// Conservative view frustum test for voxel regions in clip space. Only the side planes and the camera plane are
+/// tested, as the near and far plane distances of the Volcanite camera do not match the VTK scene scale.
+struct ViewFrustum {
+    glm::mat4 voxel_to_clip = glm::mat4(1.f);
+
+    /// @return false if the region is guaranteed to be invisible, true if it may be visible
+    [[nodiscard]] bool intersects(const VoxelRegion &region) const {
+        if (region.empty())
+            return false;
+
+        // voxel centers are at integer coordinates
+        glm::vec4 corners[8];
+        for (int c = 0; c < 8; c++) {
+            corners[c] = voxel_to_clip * glm::vec4(static_cast<float>((c & 1) ? region.max[0] : region.min[0]) - 0.5f,
+                                                   static_cast<float>((c & 2) ? region.max[1] : region.min[1]) - 0.5f,
+                                                   static_cast<float>((c & 4) ? region.max[2] : region.min[2]) - 0.5f,
+                                                   1.f);
+        }
+
+        // the region is culled if all of its corners lie outside of one plane: -w <= x,y <= w and w >= 0
+        const auto outside = [&corners](auto &&plane) {
+            for (const glm::vec4 &c : corners) {
+                if (plane(c) >= 0.f)
+                    return false;
+            }
+            return true;
+        };
+        return !(outside([](const glm::vec4 &c) { return c.w + c.x; }) || outside([](const glm::vec4 &c) { return c.w - c.x; })
+                 || outside([](const glm::vec4 &c) { return c.w + c.y; }) || outside([](const glm::vec4 &c) { return c.w - c.y; })
+                 || outside([](const glm::vec4 &c) { return c.w; }));
+    }
+};
+
+} // namespace vvv
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "label_index.hpp"
+#include "label_stats.hpp"
+#include "MappedFile.hpp"
+#include "util.hpp"
+#include "VoxelRegion.hpp"
+
+namespace vvv {
+
+/// Identifies the source of a preprocessed volume. A cache entry is only valid for the exact same key.
+struct VolumeCacheKey {
+    std::filesystem::path source;   ///< absolute path of the source volume file
+    uint64_t size = 0u;             ///< source file size in bytes
+    int64_t mtime = 0;              ///< source file last write time in nanoseconds
+    VoxelRegion region = {};        ///< requested (unclamped) region of the volume
+    double axis_scale[3] = {1., 1., 1.};
+
+    static VolumeCacheKey of(const std::filesystem::path &source, const VoxelRegion &region, const glm::vec3 &axis_scale) {
+        VolumeCacheKey key;
+        key.source = std::filesystem::absolute(source).lexically_normal();
+        key.size = std::filesystem::file_size(source);
+        key.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::filesystem::last_write_time(source).time_since_epoch()).count();
+        key.region = region;
+        for (int a = 0; a < 3; a++)
+            key.axis_scale[a] = axis_scale[a];
+        return key;
+    }
+
+    /// @return a hash of the key used for naming the cache file
+    [[nodiscard]] uint64_t hash() const {
+        // FNV-1a
+        uint64_t h = 14695981039346656037ull;
+        const auto add = [&h](const void *data, const size_t bytes) {
+            for (size_t i = 0; i < bytes; i++)
+                h = (h ^ static_cast<const unsigned char *>(data)[i]) * 1099511628211ull;
+        };
+        const std::string path = source.string();
+        add(path.data(), path.size());
+        add(&size, sizeof(size));
+        add(&mtime, sizeof(mtime));
+        add(region.min, sizeof(region.min));
+        add(region.max, sizeof(region.max));
+        add(axis_scale, sizeof(axis_scale));
+        return h;
+    }
+};
+
+/// Header in the first page of a volume cache file. The file is laid out as
+/// [header page | label payload (page aligned) | histogram entries] so that the payload can be mapped directly.
+struct VolumeCacheHeader {
+    static constexpr char MAGIC[8] = {'V', 'V', 'V', 'C', 'A', 'C', 'H', 'E'};
+    static constexpr uint32_t VERSION = 1u;
+    static constexpr size_t ALIGNMENT = 4096u;
+
+    struct HistogramEntry {
+        uint32_t label;
+        uint32_t padding;
+        uint64_t count;
+    };
+
+    char magic[8];
+    uint32_t version;
+    int32_t vtk_type;                   ///< VTK scalar type of the labels
+    // key
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t region_min[3];
+    uint64_t region_max[3];
+    double axis_scale[3];
+    // image geometry
+    int32_t dimensions[3];
+    int32_t padding;
+    double spacing[3];
+    double origin[3];
+    double volume_bounds[6];            ///< world space bounds of the complete volume, even if only a region is stored
+    // label statistics
+    uint32_t label_min;
+    uint32_t label_max;
+    uint64_t voxels;
+    // payload
+    uint64_t payload_offset;
+    uint64_t payload_bytes;
+    uint64_t histogram_offset;
+    uint64_t histogram_entries;
+    char source_path[3072];             ///< null terminated absolute path of the source volume
+
+    [[nodiscard]] bool matches(const VolumeCacheKey &key) const {
+        if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION)
+            return false;
+        if (source_size != key.size || source_mtime != key.mtime || key.source.string() != source_path)
+            return false;
+        for (int a = 0; a < 3; a++) {
+            if (region_min[a] != key.region.min[a] || region_max[a] != key.region.max[a] || axis_scale[a] != key.axis_scale[a])
+                return false;
+        }
+        return true;
+    }
+};
+static_assert(sizeof(VolumeCacheHeader) <= VolumeCacheHeader::ALIGNMENT);
+
+/// Header of a label index file that is stored next to a volume cache file, followed by the index entries.
+struct LabelIndexCacheHeader {
+    static constexpr char MAGIC[8] = {'V', 'V', 'V', 'L', 'I', 'D', 'X', '0'};
+    static constexpr uint32_t VERSION = 1u;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t padding;
+    uint64_t key_hash;                  ///< hash of the volume cache key
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t entries;
+
+    [[nodiscard]] bool matches(const VolumeCacheKey &key) const {
+        return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 && version == VERSION && key_hash == key.hash()
+               && source_size == key.size && source_mtime == key.mtime;
+    }
+};
+
+/// Private memory mapping of a complete volume cache file. The labels are mapped copy-on-write so that they can be
+/// modified in place (e.g. remapped) without changing the cache file. Must outlive all images created from it.
+class MappedVolumeCacheEntry {
+  public:
+    explicit MappedVolumeCacheEntry(const std::filesystem::path &path) : m_file(path) {}
+
+    [[nodiscard]] const VolumeCacheHeader &header() const { return *reinterpret_cast<const VolumeCacheHeader *>(m_file.data()); }
+    [[nodiscard]] void *labels() const { return m_file.data() + header().payload_offset; }
+
+    /// @return true if the file is large enough for the header and all sections it references
+    [[nodiscard]] bool complete() const {
+        if (m_file.size() < VolumeCacheHeader::ALIGNMENT)
+            return false;
+        const VolumeCacheHeader &h = header();
+        return h.payload_offset + h.payload_bytes <= m_file.size()
+               && h.histogram_offset + h.histogram_entries * sizeof(VolumeCacheHeader::HistogramEntry) <= m_file.size();
+    }
+
+    /// Hints the kernel to start reading the labels ahead as they are accessed as a whole during the upload.
+    void prefetch() const { m_file.advise(header().payload_offset, header().payload_bytes, MADV_WILLNEED); }
+
+    [[nodiscard]] LabelStatistics statistics() const {
+        LabelStatistics stats;
+        stats.min = header().label_min;
+        stats.max = header().label_max;
+        stats.voxels = header().voxels;
+        const auto *entries = reinterpret_cast<const VolumeCacheHeader::HistogramEntry *>(m_file.data() + header().histogram_offset);
+        stats.histogram.reserve(header().histogram_entries);
+        for (uint64_t i = 0; i < header().histogram_entries; i++)
+            stats.histogram.emplace(entries[i].label, entries[i].count);
+        return stats;
+    }
+
+    /// @return an image that uses the mapped labels as its scalars without copying them
+    [[nodiscard]] vtkSmartPointer<vtkImageData> createImage() const {
+        const VolumeCacheHeader &h = header();
+        auto image = vtkSmartPointer<vtkImageData>::New();
+        image->SetDimensions(h.dimensions[0], h.dimensions[1], h.dimensions[2]);
+        image->SetSpacing(h.spacing[0], h.spacing[1], h.spacing[2]);
+        image->SetOrigin(h.origin[0], h.origin[1], h.origin[2]);
+        setExternalLabelScalars(image, h.vtk_type, labels());
+        return image;
+    }
+
+  private:
+    MappedFile m_file;
+};
+
+/// On-disk cache of imported segmentation volumes and their label statistics. Cache files are keyed by the source
+/// file path, size, modification time, the requested region and axis scale and are reloaded through mmap.
+class VolumeCache {
+  public:
+    explicit VolumeCache(std::filesystem::path directory) : m_directory(std::move(directory)) {}
+
+    [[nodiscard]] std::filesystem::path file(const VolumeCacheKey &key) const {
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(key.hash()));
+        return m_directory / (key.source.stem().string() + "-" + hash + ".vvvcache");
+    }
+
+    [[nodiscard]] std::filesystem::path indexFile(const VolumeCacheKey &key) const {
+        std::filesystem::path path = file(key);
+        path.replace_extension(".vvvindex");
+        return path;
+    }
+
+    /// @return the label index stored for the given key or an empty optional if no valid index exists
+    [[nodiscard]] std::optional<LabelIndex> loadLabelIndex(const VolumeCacheKey &key) const {
+        std::ifstream in(indexFile(key), std::ios::binary);
+        if (!in.is_open())
+            return {};
+        LabelIndexCacheHeader h = {};
+        if (!in.read(reinterpret_cast<char *>(&h), sizeof(h)) || !h.matches(key))
+            return {};
+        std::vector<LabelIndexEntry> entries(h.entries);
+        if (!in.read(reinterpret_cast<char *>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(LabelIndexEntry))))
+            return {};
+        LabelIndex index;
+        for (const auto &e : entries)
+            index.add(e);
+        return index;
+    }
+
+    /// Writes the label index of the volume with the given key next to its cache entry, via a temporary file.
+    /// @return true if the index was written successfully
+    bool storeLabelIndex(const VolumeCacheKey &key, const LabelIndex &index) const {
+        LabelIndexCacheHeader h = {};
+        std::memcpy(h.magic, LabelIndexCacheHeader::MAGIC, sizeof(h.magic));
+        h.version = LabelIndexCacheHeader::VERSION;
+        h.key_hash = key.hash();
+        h.source_size = key.size;
+        h.source_mtime = key.mtime;
+        h.entries = index.size();
+
+        std::vector<LabelIndexEntry> entries;
+        entries.reserve(index.size());
+        for (const auto &[label, entry] : index.entries())
+            entries.push_back(entry);
+
+        const std::filesystem::path path = indexFile(key);
+        const std::filesystem::path tmp_path = path.string() + ".tmp" + std::to_string(getpid());
+        std::error_code ec;
+        std::filesystem::create_directories(m_directory, ec);
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!out.is_open())
+                return false;
+            out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+            out.write(reinterpret_cast<const char *>(entries.data()),
+                      static_cast<std::streamsize>(entries.size() * sizeof(LabelIndexEntry)));
+            if (!out.good()) {
+                out.close();
+                std::filesystem::remove(tmp_path, ec);
+                return false;
+            }
+        }
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec) {
+            std::filesystem::remove(tmp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+    /// Maps the cache entry of the given key into memory.
+    /// @return the mapped entry or nullptr if no valid entry exists for the key
+    [[nodiscard]] std::unique_ptr<MappedVolumeCacheEntry> load(const VolumeCacheKey &key) const {
+        const std::filesystem::path path = file(key);
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(path, ec))
+            return nullptr;
+        std::unique_ptr<MappedVolumeCacheEntry> entry;
+        try {
+            entry = std::make_unique<MappedVolumeCacheEntry>(path);
+        } catch (const std::runtime_error &) {
+            return nullptr;
+        }
+        if (!entry->complete() || !entry->header().matches(key))
+            return nullptr;
+        entry->prefetch();
+        return entry;
+    }
+
+    /// Writes the image labels and statistics as cache entry for the given key. The file is written to a temporary
+    /// file first and renamed afterward, so concurrent runs never observe partial entries.
+    /// @return true if the entry was written successfully
+    bool store(const VolumeCacheKey &key, vtkImageData *image, const double (&volume_bounds)[6],
+               const LabelStatistics &stats) const {
+        if (key.source.string().size() >= sizeof(VolumeCacheHeader::source_path))
+            return false;
+
+        VolumeCacheHeader h = {};
+        std::memcpy(h.magic, VolumeCacheHeader::MAGIC, sizeof(h.magic));
+        h.version = VolumeCacheHeader::VERSION;
+        h.vtk_type = image->GetScalarType();
+        h.source_size = key.size;
+        h.source_mtime = key.mtime;
+        for (int a = 0; a < 3; a++) {
+            h.region_min[a] = key.region.min[a];
+            h.region_max[a] = key.region.max[a];
+            h.axis_scale[a] = key.axis_scale[a];
+        }
+        image->GetDimensions(h.dimensions);
+        image->GetSpacing(h.spacing);
+        image->GetOrigin(h.origin);
+        std::copy_n(volume_bounds, 6, h.volume_bounds);
+        h.label_min = stats.min;
+        h.label_max = stats.max;
+        h.voxels = static_cast<uint64_t>(image->GetNumberOfPoints());
+        h.payload_offset = VolumeCacheHeader::ALIGNMENT;
+        h.payload_bytes = h.voxels * static_cast<uint64_t>(image->GetScalarSize());
+        h.histogram_offset = (h.payload_offset + h.payload_bytes + 7u) & ~uint64_t{7u};
+        h.histogram_entries = stats.histogram.size();
+        std::strncpy(h.source_path, key.source.c_str(), sizeof(h.source_path) - 1);
+
+        std::vector<VolumeCacheHeader::HistogramEntry> entries;
+        entries.reserve(stats.histogram.size());
+        for (const auto &[label, count] : stats.histogram)
+            entries.push_back({label, 0u, count});
+
+        const std::filesystem::path path = file(key);
+        const std::filesystem::path tmp_path = path.string() + ".tmp" + std::to_string(getpid());
+        std::error_code ec;
+        std::filesystem::create_directories(m_directory, ec);
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!out.is_open())
+                return false;
+            const std::vector<char> zeros(VolumeCacheHeader::ALIGNMENT, 0);
+            out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+            out.write(zeros.data(), static_cast<std::streamsize>(h.payload_offset - sizeof(h)));
+            out.write(static_cast<const char *>(image->GetScalarPointer()), static_cast<std::streamsize>(h.payload_bytes));
+            out.write(zeros.data(), static_cast<std::streamsize>(h.histogram_offset - h.payload_offset - h.payload_bytes));
+            out.write(reinterpret_cast<const char *>(entries.data()),
+                      static_cast<std::streamsize>(entries.size() * sizeof(VolumeCacheHeader::HistogramEntry)));
+            if (!out.good()) {
+                out.close();
+                std::filesystem::remove(tmp_path, ec);
+                return false;
+            }
+        }
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec) {
+            std::filesystem::remove(tmp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    std::filesystem::path m_directory;
+};
+
+} // namespace vvv
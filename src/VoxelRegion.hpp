@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace vvv {
+
+/// Axis aligned box of voxels [min, max) in xyz order. The default region covers any volume completely and has to be
+/// clamped to the volume dimensions before its extent can be used.
+struct VoxelRegion {
+    size_t min[3] = {0u, 0u, 0u};
+    size_t max[3] = {SIZE_MAX, SIZE_MAX, SIZE_MAX};
+
+    /// @return the region covering a complete volume of the given dimensions
+    static VoxelRegion full(const size_t (&dim_xyz)[3]) {
+        return {{0u, 0u, 0u}, {dim_xyz[0], dim_xyz[1], dim_xyz[2]}};
+    }
+
+    /// @return the intersection of this region with a volume of the given dimensions
+    [[nodiscard]] VoxelRegion clamped(const size_t (&dim_xyz)[3]) const {
+        VoxelRegion r;
+        for (int a = 0; a < 3; a++) {
+            r.max[a] = std::min(max[a], dim_xyz[a]);
+            r.min[a] = std::min(min[a], r.max[a]);
+        }
+        return r;
+    }
+
+    /// @return the intersection of both regions
+    [[nodiscard]] VoxelRegion intersect(const VoxelRegion &other) const {
+        VoxelRegion r;
+        for (int a = 0; a < 3; a++) {
+            r.max[a] = std::min(max[a], other.max[a]);
+            r.min[a] = std::min(std::max(min[a], other.min[a]), r.max[a]);
+        }
+        return r;
+    }
+
+    [[nodiscard]] size_t extent(const int axis) const { return max[axis] - min[axis]; }
+    [[nodiscard]] size_t voxels() const { return extent(0) * extent(1) * extent(2); }
+    [[nodiscard]] bool empty() const { return voxels() == 0u; }
+
+    [[nodiscard]] bool covers(const size_t (&dim_xyz)[3]) const {
+        return min[0] == 0u && min[1] == 0u && min[2] == 0u
+               && max[0] >= dim_xyz[0] && max[1] >= dim_xyz[1] && max[2] >= dim_xyz[2];
+    }
+
+    bool operator==(const VoxelRegion &) const = default;
+};
+
+inline std::ostream &operator<<(std::ostream &out, const VoxelRegion &r) {
+    return out << "[" << r.min[0] << "," << r.min[1] << "," << r.min[2] << "]-["
+               << r.max[0] << "," << r.max[1] << "," << r.max[2] << ")";
+}
+
+} // namespace vvv
@@ -17,6 +17,33 @@ enum DataSet
 };
 constexpr int DATA_SET_COUNT = 9;
 
+enum RendererBackend
+{
+    GPU_RAYCAST = 0,        ///< VTK OpenGL GPU ray casting with opacity compositing
+    CPU_FIRST_HIT = 1,      ///< multithreaded CPU ray casting that stops at the first visible label
+    CPU_FIXED_POINT = 2,    ///< VTK multithreaded fixed point CPU ray casting with opacity compositing
+    SMART = 3,              ///< VTK smart volume mapper that picks GPU ray casting if supported, CPU ray casting otherwise
+};
+constexpr int RENDERER_BACKEND_COUNT = 4;
+
+/// @return the command line name of the backend that is also written to the results file
+inline std::string getRendererName(const RendererBackend renderer)
+{
+    switch (renderer)
+    {
+    case GPU_RAYCAST:
+        return "gpu";
+    case CPU_FIRST_HIT:
+        return "cpu";
+    case CPU_FIXED_POINT:
+        return "fixed-point";
+    case SMART:
+        return "smart";
+    default:
+        throw std::invalid_argument("Invalid renderer backend.");
+    }
+}
+
 struct Config
 {
     bool verbose = false;
@@ -26,21 +53,48 @@ struct Config
     bool offscreen = false;
     std::filesystem::path camera_import_file = {};
     std::filesystem::path camera_export_file = "./camera.cam";
+    std::optional<std::filesystem::path> camera_list_file = {}; ///< batch mode: render each view of this camera list
+    int orbit_views = 0;                ///< batch mode: render this many views on an orbit around the focal point
+    std::string camera_path = {};       ///< move the camera along an orbit, dolly or flythrough path while rendering frames
+    std::optional<std::filesystem::path> camera_keyframes_file = {}; ///< Volcanite camera keyframes of the flythrough path
+    std::optional<std::string> serve_socket = {}; ///< answer render requests on this Unix socket ("-" for stdin) instead of benchmarking
     std::filesystem::path image_export_dir = "./";
     std::optional<std::filesystem::path> image_export_override_file = {};
     std::filesystem::path data_base_dir = "./";
+    std::optional<std::filesystem::path> volume_override_file = {};
     std::filesystem::path vcfg_base_dir = "./";
     std::optional<std::filesystem::path> vcfg_override_file = {};
+    std::optional<std::filesystem::path> attribute_file = {}; ///< per-label attributes (.csv or .hdf5) for material discrimination
     std::filesystem::path csv_result_file = "./results.csv";
     // note: Griesser2022-sample, Motta2019, H01-wm, H01-bloodvessel, liconn unavailable: exceed 64 GB RAM.
     DataSet data_set = AZBA;
     bool exit_with_data_count = false;  ///< returns the data set count and exits
+    bool load_roi = false;              ///< only load the volume region within the .vcfg split planes
+    bool tight_crop = false;            ///< crop the volume to the bounding box of visible labels within the split planes
+    bool indexed_colors = false;        ///< exact per-label colors and opacities instead of a 256 point color ramp
+    bool material_colors = false;       ///< bake the .vcfg material color maps into a per-label color table
+    bool material_volume = false;       ///< replace labels by 8 bit material indices before rendering
+    bool label_index = false;           ///< build a per-label index of voxel counts, bounds and centroids
+    bool remap_labels = false;          ///< relabel the volume densely with visible labels first for an exact opacity TF
+    unsigned thread_count = 0u;         ///< worker threads for parallel import and preprocessing, 0 = all hardware threads
+    std::optional<std::filesystem::path> cache_dir = {}; ///< directory of the preprocessed volume cache, disabled if unset
+    bool out_of_core = false;           ///< read .hdf5 volumes brick-wise, only loading bricks within split planes and view
+    double memory_budget_gb = 16.;      ///< memory budget of the out-of-core brick cache in GB
+    unsigned brick_size = 128u;         ///< edge length of out-of-core bricks in voxels
+    std::optional<std::filesystem::path> shared_volume_dir = {}; ///< publish / attach preprocessed volumes in this shared memory directory
+    bool verify_shared_volume = false;  ///< checksum the labels of attached shared volumes
+    RendererBackend renderer = GPU_RAYCAST; ///< volume rendering backend
+    bool distance_leaping = false;      ///< CPU renderer skips empty space with a distance field instead of a mip hierarchy
+    int lod_level = 0;                  ///< label pyramid level to render, -1 selects the coarsest sub-pixel level
 };
 
 
 // TODO: separate all code paths / configs for the Volcanite evaluation from the more general code
 std::filesystem::path getDataInputPath(const Config& config, const DataSet data)
 {
+    if (config.volume_override_file.has_value())
+        return config.volume_override_file.value();
+
     std::filesystem::path postfix = {};
     switch (data)
     {
@@ -137,6 +191,21 @@ inline Config parseConfig(int argc, char** argv)
     TCLAP::ValueArg<std::string> camExportArg("",
         "camera-export", "Camera export file", false,
         config.camera_export_file.string(), "path", cmd);
+    TCLAP::ValueArg<std::string> camListArg("",
+        "camera-list", "Render each view of a file with concatenated camera exports, reusing the loaded volume", false,
+        "", "path", cmd);
+    TCLAP::ValueArg<int> orbitArg("",
+        "orbit", "Render this many views on an orbit around the camera focal point, reusing the loaded volume", false,
+        config.orbit_views, "int", cmd);
+    std::vector<std::string> cameraPathNames = {"orbit", "dolly", "flythrough"};
+    TCLAP::ValuesConstraint<std::string> cameraPathConstraint(cameraPathNames);
+    TCLAP::ValueArg<std::string> cameraPathArg("",
+        "camera-path", "Move the .vcfg camera in every frame: a full orbit, a dolly towards the look at point and back, "
+        "or a spline flythrough of --camera-keyframes. Frame times are also written to <results-file>_frames.csv", false,
+        "", &cameraPathConstraint, cmd);
+    TCLAP::ValueArg<std::string> cameraKeyframesArg("",
+        "camera-keyframes", "Volcanite cameras in human readable format, one after another, for --camera-path flythrough",
+        false, "", "path", cmd);
     TCLAP::ValueArg<std::string> imgExportArg("",
         "image-dir", "Image export directory", false,
         config.image_export_dir.string(), "path", cmd);
@@ -146,17 +215,85 @@ inline Config parseConfig(int argc, char** argv)
     TCLAP::ValueArg<std::string> dataBaseArg("",
         "data-dir", "Data base directory", false,
         config.data_base_dir.string(), "path", cmd);
+    TCLAP::ValueArg<std::string> volumeOverrideFileArg("",
+        "volume-file", "Segmentation volume file .hdf5, .vti, .nhdr or .nrrd (overrides auto select from data-dir)",
+        false, "", "path", cmd);
     TCLAP::ValueArg<std::string> vcfgBaseArg("",
             "vcfg-dir", ".vcfg base directory", false,
             config.vcfg_base_dir.string(), "path", cmd);
     TCLAP::ValueArg<std::string> vcfgOverrideFileArg("",
             "vcfg-file", ".vcfg configuration file (overrides auto select from vcfg-dir)", false,
             "", "path", cmd);
+    TCLAP::ValueArg<std::string> attributeFileArg("",
+            "attributes", "Per-label attribute file (.csv or .hdf5) for materials that discriminate labels by attribute",
+            false, "", "path", cmd);
     TCLAP::ValueArg<std::string> resultFileArg("",
             "results-file", "Results .csv file", false,
             config.csv_result_file.string(), "path", cmd);
     TCLAP::ValueArg<int> dataSetArg("d", "data-set",
-    "Data set index in [0 ... 6]", false, config.data_set, "int", cmd);
+    "Data set index in [0 ... " + std::to_string(DATA_SET_COUNT - 1) + "]", false, config.data_set, "int", cmd);
+    TCLAP::SwitchArg roiArg("", "roi",
+        "Only read the volume region within the .vcfg split planes from .hdf5 files", cmd, config.load_roi);
+    TCLAP::SwitchArg remapArg("", "remap-labels",
+        "Relabel the volume densely with all visible labels first to obtain an exact opacity transfer function", cmd,
+        config.remap_labels);
+    TCLAP::SwitchArg tightCropArg("", "tight-crop",
+        "Crop the volume to the bounding box of all visible labels within the split planes before rendering", cmd,
+        config.tight_crop);
+    TCLAP::SwitchArg indexedColorsArg("", "indexed-colors",
+        "Look up an exact color and opacity per label instead of sampling a 256 point color ramp", cmd,
+        config.indexed_colors);
+    TCLAP::SwitchArg materialColorsArg("", "material-colors",
+        "Color labels with the material color maps of the .vcfg file, baked into an exact per-label lookup table", cmd,
+        config.material_colors);
+    TCLAP::SwitchArg materialVolumeArg("", "material-volume",
+        "Classify labels into an 8 bit material index volume before rendering, colored per material", cmd,
+        config.material_volume);
+    TCLAP::SwitchArg labelIndexArg("", "label-index",
+        "Build a per-label index of voxel counts, bounds and centroids (stored next to the --cache-dir entry)", cmd,
+        config.label_index);
+    TCLAP::ValueArg<unsigned> threadsArg("", "threads",
+        "Worker threads for parallel volume import and preprocessing (0 = all hardware threads)", false,
+        config.thread_count, "int", cmd);
+    TCLAP::ValueArg<std::string> cacheDirArg("",
+        "cache-dir", "Directory for caching imported volumes that are memory mapped on subsequent runs", false,
+        "", "path", cmd);
+    TCLAP::SwitchArg outOfCoreArg("", "out-of-core",
+        "Read .hdf5 volumes brick by brick and only keep bricks within the split planes and view frustum in memory", cmd,
+        config.out_of_core);
+    TCLAP::ValueArg<double> memoryBudgetArg("", "memory-budget",
+        "Memory budget of the out-of-core brick cache in GB", false, config.memory_budget_gb, "float", cmd);
+    TCLAP::ValueArg<unsigned> brickSizeArg("", "brick-size",
+        "Edge length of out-of-core bricks in voxels, ideally a multiple of the .hdf5 chunk size", false,
+        config.brick_size, "int", cmd);
+    TCLAP::ValueArg<std::string> sharedVolumeArg("", "shared-volume",
+        "Publish the preprocessed volume in this shared memory directory (e.g. /dev/shm or a hugetlbfs mount) so that "
+        "concurrent runs with the same volume and parameters attach to it read-only instead of importing it", false,
+        "", "path", cmd);
+    TCLAP::SwitchArg verifySharedVolumeArg("", "verify-shared-volume",
+        "Checksum the labels of an attached shared volume against the checksum computed when it was published", cmd,
+        config.verify_shared_volume);
+    std::vector<std::string> rendererNames;
+    for (int i = 0; i < RENDERER_BACKEND_COUNT; i++)
+        rendererNames.push_back(getRendererName(static_cast<RendererBackend>(i)));
+    TCLAP::ValuesConstraint<std::string> rendererConstraint(rendererNames);
+    TCLAP::ValueArg<std::string> rendererArg("", "renderer",
+        "Volume rendering backend: VTK GPU ray casting (gpu), multithreaded CPU first-hit ray casting (cpu), "
+        "VTK fixed point CPU ray casting (fixed-point) or the VTK smart volume mapper (smart)", false,
+        getRendererName(config.renderer), &rendererConstraint, cmd);
+    TCLAP::SwitchArg distanceLeapingArg("", "distance-leaping",
+        "CPU renderer leaps over empty space with a Chebyshev distance field instead of the occupancy mip hierarchy", cmd,
+        config.distance_leaping);
+    TCLAP::ValueArg<int> lodArg("", "lod",
+        "Label pyramid level to render, each level halves the resolution by majority downsampling "
+        "(0 = full resolution, -1 = coarsest level at which voxels stay sub-pixel for the .vcfg camera)", false,
+        config.lod_level, "int", cmd);
+    TCLAP::ValueArg<std::string> serveArg("", "serve",
+        "Keep the volume loaded and answer JSON render requests, one per line, on this Unix domain socket path or on "
+        "stdin for -. Requests may set width, height, output, a VTK view (position, focal_point, view_up) or a "
+        "Volcanite camera (rotation_x, rotation_y, orbital_radius, look_at) and the indices of the .vcfg materials "
+        "to render (materials). The server renders only the data set it was started with, requests for another "
+        "data_set are rejected", false, "", "path", cmd);
     TCLAP::SwitchArg listDataArg("", "list-data",
         "Prints all data set IDs to the console and exits. Returns the data set count.", cmd, false);
 
@@ -180,19 +317,64 @@ inline Config parseConfig(int argc, char** argv)
         config.camera_import_file = std::filesystem::path(camImportArg.getValue());
     if (camExportArg.isSet())
         config.camera_export_file = std::filesystem::path(camExportArg.getValue());
+    if (camListArg.isSet())
+        config.camera_list_file = std::filesystem::path(camListArg.getValue());
+    config.orbit_views = orbitArg.getValue();
+    if (config.orbit_views < 0)
+        throw std::invalid_argument("--orbit must be a non-negative view count");
+    if (config.camera_list_file.has_value() && config.orbit_views > 0)
+        throw std::invalid_argument("--camera-list and --orbit can not be combined");
+    config.camera_path = cameraPathArg.getValue();
+    if (cameraKeyframesArg.isSet())
+        config.camera_keyframes_file = std::filesystem::path(cameraKeyframesArg.getValue());
+    if (config.camera_path == "flythrough" && !config.camera_keyframes_file.has_value())
+        throw std::invalid_argument("--camera-path flythrough requires --camera-keyframes");
+    if (!config.camera_path.empty() && (config.camera_list_file.has_value() || config.orbit_views > 0))
+        throw std::invalid_argument("--camera-path can not be combined with --camera-list or --orbit");
     if (imgExportArg.isSet())
         config.image_export_dir = std::filesystem::path(imgExportArg.getValue());
     if (imgExportOverrideFileArg.isSet())
         config.image_export_override_file = std::filesystem::path(imgExportOverrideFileArg.getValue());
     if (dataBaseArg.isSet())
         config.data_base_dir = std::filesystem::path(dataBaseArg.getValue());
+    if (volumeOverrideFileArg.isSet())
+        config.volume_override_file = std::filesystem::path(volumeOverrideFileArg.getValue());
     if (vcfgBaseArg.isSet())
         config.vcfg_base_dir = std::filesystem::path(vcfgBaseArg.getValue());
     if (vcfgOverrideFileArg.isSet())
         config.vcfg_override_file = std::filesystem::path(vcfgOverrideFileArg.getValue());
+    if (attributeFileArg.isSet())
+        config.attribute_file = std::filesystem::path(attributeFileArg.getValue());
     if (resultFileArg.isSet())
         config.csv_result_file = std::filesystem::path(resultFileArg.getValue());
     config.data_set = static_cast<DataSet>(dataSetArg.getValue());
+    config.load_roi = roiArg.getValue();
+    config.remap_labels = remapArg.getValue();
+    config.tight_crop = tightCropArg.getValue();
+    config.indexed_colors = indexedColorsArg.getValue();
+    config.material_colors = materialColorsArg.getValue();
+    config.material_volume = materialVolumeArg.getValue();
+    config.label_index = labelIndexArg.getValue();
+    config.thread_count = threadsArg.getValue();
+    if (cacheDirArg.isSet())
+        config.cache_dir = std::filesystem::path(cacheDirArg.getValue());
+    config.out_of_core = outOfCoreArg.getValue();
+    config.memory_budget_gb = memoryBudgetArg.getValue();
+    config.brick_size = brickSizeArg.getValue();
+    if (sharedVolumeArg.isSet())
+        config.shared_volume_dir = std::filesystem::path(sharedVolumeArg.getValue());
+    config.verify_shared_volume = verifySharedVolumeArg.getValue();
+    for (int i = 0; i < RENDERER_BACKEND_COUNT; i++)
+        if (rendererArg.getValue() == getRendererName(static_cast<RendererBackend>(i)))
+            config.renderer = static_cast<RendererBackend>(i);
+    config.distance_leaping = distanceLeapingArg.getValue();
+    config.lod_level = lodArg.getValue();
+    if (serveArg.isSet())
+        config.serve_socket = serveArg.getValue();
+    if (config.shared_volume_dir.has_value() && config.out_of_core)
+        throw std::invalid_argument("--shared-volume requires the complete volume and can not be used with --out-of-core");
+    if (config.lod_level < -1)
+        throw std::invalid_argument("--lod must be -1 (automatic) or a non-negative pyramid level");
 
     return config;
 }
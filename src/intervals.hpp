@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+struct Interval {
+    uint32_t start;
+    uint32_t end;
+};
+
+inline std::vector<Interval> mergeIntervals(std::vector<Interval> &intervals) {
+    if (intervals.empty()) {
+        return {};
+    }
+
+    // Sort intervals by their start value
+    std::sort(intervals.begin(), intervals.end(), [](const Interval a, const Interval b) {
+        return a.start < b.start;
+    });
+
+    std::vector<Interval> merged;
+
+    // Push first interval to merged
+    merged.push_back(intervals[0]);
+
+    for (size_t i = 1; i < intervals.size(); ++i) {
+        // Reference to last merged interval
+
+        if (auto& [start, end] = merged.back(); end >= intervals[i].start) {
+            // If overlapping, merge by extending the end if needed
+            if (end < intervals[i].end) {
+                end = intervals[i].end;
+            }
+        } else {
+            // No overlap, add interval to merged
+            merged.push_back(intervals[i]);
+        }
+    }
+
+    return merged;
+}
+
+/// @param merged sorted, non-overlapping intervals as returned by mergeIntervals
+/// @return true if label lies within one of the merged intervals
+inline bool intervalsContain(const std::vector<Interval> &merged, const uint32_t label) {
+    // find the last interval starting at or before label
+    const auto it = std::upper_bound(merged.begin(), merged.end(), label, [](const uint32_t l, const Interval &i) {
+        return l < i.start;
+    });
+    return it != merged.begin() && label <= std::prev(it)->end;
+}
+
+/// @param merged sorted, non-overlapping intervals as returned by mergeIntervals
+/// @return the sorted parts of the interval that are not covered by the merged intervals
+inline std::vector<Interval> subtractIntervals(const Interval interval, const std::vector<Interval> &merged) {
+    std::vector<Interval> rest;
+    uint64_t start = interval.start;
+    for (const auto &i : merged) {
+        if (i.end < start)
+            continue;
+        if (i.start > interval.end)
+            break;
+        if (i.start > start)
+            rest.push_back({static_cast<uint32_t>(start), i.start - 1u});
+        start = static_cast<uint64_t>(i.end) + 1u;
+    }
+    if (start <= interval.end)
+        rest.push_back({static_cast<uint32_t>(start), interval.end});
+    return rest;
+}
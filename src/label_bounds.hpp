@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "parallel.hpp"
+#include "VoxelRegion.hpp"
+
+namespace vvv {
+
+/// Computes the bounding region of all voxels with a visible label within the given region of a volume. Rows are
+/// scanned in parallel from both ends, each worker keeps partial bounds that are merged at the end.
+/// @param visible callable with signature bool(uint32_t label)
+/// @param within region of the volume that is searched, clamped to the volume dimensions
+/// @return the bounding region of all visible voxels, an empty region if there are none
+template <typename T, typename F>
+VoxelRegion visibleLabelRegion(const T *labels, const size_t (&dim)[3], F &&visible, const VoxelRegion &within,
+                               const unsigned thread_count = 0u) {
+    const VoxelRegion search = within.clamped(dim);
+    if (search.empty())
+        return VoxelRegion::full({0u, 0u, 0u});
+
+    struct Bounds {
+        size_t min[3] = {SIZE_MAX, SIZE_MAX, SIZE_MAX};
+        size_t max[3] = {0u, 0u, 0u};
+    };
+    std::vector<Bounds> partial(resolve_thread_count(thread_count));
+    const size_t rows_y = search.extent(1);
+    parallel_for(rows_y * search.extent(2), thread_count, [&](const size_t row, const unsigned thread_idx) {
+        const size_t y = search.min[1] + row % rows_y, z = search.min[2] + row / rows_y;
+        const T *line = labels + (z * dim[1] + y) * dim[0];
+        size_t first = search.min[0];
+        while (first < search.max[0] && !visible(static_cast<uint32_t>(line[first])))
+            first++;
+        if (first == search.max[0])
+            return;
+        size_t last = search.max[0] - 1u;
+        while (!visible(static_cast<uint32_t>(line[last])))
+            last--;
+
+        Bounds &b = partial[thread_idx];
+        const size_t lo[3] = {first, y, z}, hi[3] = {last + 1u, y + 1u, z + 1u};
+        for (int a = 0; a < 3; a++) {
+            b.min[a] = std::min(b.min[a], lo[a]);
+            b.max[a] = std::max(b.max[a], hi[a]);
+        }
+    });
+
+    Bounds merged;
+    for (const Bounds &b : partial) {
+        for (int a = 0; a < 3; a++) {
+            merged.min[a] = std::min(merged.min[a], b.min[a]);
+            merged.max[a] = std::max(merged.max[a], b.max[a]);
+        }
+    }
+    if (merged.min[0] == SIZE_MAX)
+        return VoxelRegion::full({0u, 0u, 0u});
+    return {{merged.min[0], merged.min[1], merged.min[2]}, {merged.max[0], merged.max[1], merged.max[2]}};
+}
+
+} // namespace vvv
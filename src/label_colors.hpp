@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <vtkMath.h>
+
+#include <glm/glm.hpp>
+
+#include "LabelAttributes.hpp"
+#include "parallel.hpp"
+#include "read_vcfg_tf.hpp"
+#include "util.hpp"
+
+namespace vvv {
+
+/// Largest number of labels for an indexed color lookup. VTK stores transfer functions in 1D textures whose width is
+/// limited by the OpenGL texture size (commonly 32768), larger tables would be resampled and lose exact colors.
+constexpr size_t MAX_INDEXED_LABELS = size_t{1} << 15;
+
+/// Computes a distinct color for each label in [0, count) in parallel. The hue is a hash of the original label, so an
+/// object keeps its color independent of remapping.
+/// @param original_label callable with signature uint32_t(uint32_t label) returning the original volume label
+template <typename F>
+std::vector<glm::vec3> hashedLabelColors(const size_t count, F &&original_label, const unsigned thread_count = 0u) {
+    std::vector<glm::vec3> colors(count);
+    parallel_for_blocks(count, 1u << 12, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+        for (size_t l = begin; l < end; l++) {
+            double rgb[3];
+            vtkMath::HSVToRGB(static_cast<double>(pcg_hash(original_label(static_cast<uint32_t>(l))) % 512u) / 512., 0.8, 1.,
+                              &rgb[0], &rgb[1], &rgb[2]);
+            colors[l] = glm::vec3(rgb[0], rgb[1], rgb[2]);
+        }
+    });
+    return colors;
+}
+
+/// Evaluates the color map of a material at the normalized position t in [0, 1]. Control points are evenly spaced and
+/// linearly interpolated in RGB.
+inline glm::vec3 evaluateColormap(const std::vector<glm::vec3> &colormap, const float t) {
+    if (colormap.size() == 1u)
+        return colormap[0];
+    const float x = glm::clamp(t, 0.f, 1.f) * static_cast<float>(colormap.size() - 1u);
+    const auto i = std::min(static_cast<size_t>(x), colormap.size() - 2u);
+    return glm::mix(colormap[i], colormap[i + 1u], x - static_cast<float>(i));
+}
+
+/// @return a representative color of the material with the given index: the center of its color map, or a hashed
+///         color of the index if it has no color map control points
+inline glm::vec3 materialColor(const SegmentedVolumeMaterial &material, const uint32_t index) {
+    if (!material.colormap.empty())
+        return evaluateColormap(material.colormap, 0.5f);
+    double rgb[3];
+    vtkMath::HSVToRGB(static_cast<double>(pcg_hash(index) % 512u) / 512., 0.8, 1., &rgb[0], &rgb[1], &rgb[2]);
+    return glm::vec3(rgb[0], rgb[1], rgb[2]);
+}
+
+/// Bakes the material color maps of a Volcanite configuration into one RGBA entry per label in [0, count), computed in
+/// parallel. Each label is colored by its material, with the label mapped to the material tfMinMax range and wrapped as
+/// in Volcanite. Alpha is the material opacity and 0 for labels without a material. The label itself is the color map
+/// input for any tfAttribute. Materials without color map control points, e.g. references to unknown built-in color
+/// maps, fall back to the hashed label color.
+/// @param label_materials material ids of original labels as returned by classifyLabelMaterials, may be empty
+/// @param original_label callable with signature uint32_t(uint32_t label) returning the original volume label
+template <typename F>
+std::vector<glm::vec4> materialLabelColors(const std::vector<SegmentedVolumeMaterial> &materials,
+                                           const std::vector<uint8_t> &label_materials, const size_t count,
+                                           F &&original_label, const unsigned thread_count = 0u) {
+    std::vector<glm::vec4> colors(count);
+    parallel_for_blocks(count, 1u << 12, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+        for (size_t l = begin; l < end; l++) {
+            const uint32_t label = original_label(static_cast<uint32_t>(l));
+            const uint8_t material_id = labelMaterial(materials, label_materials, label);
+            if (material_id == NO_MATERIAL) {
+                colors[l] = glm::vec4(0.f);
+                continue;
+            }
+            const auto material = materials.begin() + material_id;
+
+            glm::vec3 rgb;
+            if (material->colormap.empty()) {
+                double hsv_rgb[3];
+                vtkMath::HSVToRGB(static_cast<double>(pcg_hash(label) % 512u) / 512., 0.8, 1.,
+                                  &hsv_rgb[0], &hsv_rgb[1], &hsv_rgb[2]);
+                rgb = glm::vec3(hsv_rgb[0], hsv_rgb[1], hsv_rgb[2]);
+            } else {
+                const float range = material->tfMinMax[1] - material->tfMinMax[0];
+                float t = range != 0.f ? (static_cast<float>(label) - material->tfMinMax[0]) / range : 0.f;
+                if (material->wrapping == 1)
+                    t -= std::floor(t);
+                else if (material->wrapping == 2)
+                    t = static_cast<float>(pcg_hash(label) % 1024u) / 1023.f;
+                rgb = evaluateColormap(material->colormap, t);
+            }
+            colors[l] = glm::vec4(rgb, material->opacity);
+        }
+    });
+    return colors;
+}
+
+} // namespace vvv
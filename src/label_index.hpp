@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "intervals.hpp"
+#include "parallel.hpp"
+#include "VoxelRegion.hpp"
+
+namespace vvv {
+
+/// Voxel count, bounding region and centroid of a single label.
+struct LabelIndexEntry {
+    uint32_t label = 0u;
+    uint32_t min[3] = {UINT32_MAX, UINT32_MAX, UINT32_MAX};
+    uint32_t max[3] = {0u, 0u, 0u};                     ///< exclusive upper bound
+    uint32_t padding = 0u;
+    uint64_t count = 0u;
+    double sum[3] = {0., 0., 0.};                       ///< sum of all voxel coordinates
+
+    [[nodiscard]] VoxelRegion region() const { return {{min[0], min[1], min[2]}, {max[0], max[1], max[2]}}; }
+    [[nodiscard]] glm::dvec3 centroid() const { return glm::dvec3(sum[0], sum[1], sum[2]) / static_cast<double>(count); }
+
+    void merge(const LabelIndexEntry &other) {
+        for (int a = 0; a < 3; a++) {
+            min[a] = std::min(min[a], other.min[a]);
+            max[a] = std::max(max[a], other.max[a]);
+            sum[a] += other.sum[a];
+        }
+        count += other.count;
+    }
+};
+
+/// Per-label index of voxel counts, bounding regions and centroids in voxel coordinates of a volume. Selections of
+/// labels, e.g. materials, can be located from the index without scanning the volume again.
+class LabelIndex {
+  public:
+    /// Accumulates count consecutive labels of the row (y, z) starting at x.
+    template <typename T>
+    void addRow(const T *data, const size_t count, const uint32_t x, const uint32_t y, const uint32_t z) {
+        // neighboring voxels mostly share their label: only update the entry at the end of each run
+        size_t run_start = 0u;
+        for (size_t i = 1; i <= count; i++) {
+            if (i < count && data[i] == data[run_start])
+                continue;
+            const auto label = static_cast<uint32_t>(data[run_start]);
+            const auto first = static_cast<uint32_t>(x + run_start), last = static_cast<uint32_t>(x + i - 1u);
+            const auto run = static_cast<double>(i - run_start);
+            LabelIndexEntry &e = m_entries[label];
+            e.label = label;
+            e.min[0] = std::min(e.min[0], first);
+            e.max[0] = std::max(e.max[0], last + 1u);
+            e.min[1] = std::min(e.min[1], y);
+            e.max[1] = std::max(e.max[1], y + 1u);
+            e.min[2] = std::min(e.min[2], z);
+            e.max[2] = std::max(e.max[2], z + 1u);
+            e.count += i - run_start;
+            e.sum[0] += run * (static_cast<double>(first) + static_cast<double>(last)) * 0.5;
+            e.sum[1] += run * static_cast<double>(y);
+            e.sum[2] += run * static_cast<double>(z);
+            run_start = i;
+        }
+    }
+
+    void add(const LabelIndexEntry &entry) {
+        auto [it, inserted] = m_entries.try_emplace(entry.label, entry);
+        if (!inserted)
+            it->second.merge(entry);
+    }
+
+    void merge(const LabelIndex &other) {
+        for (const auto &[label, entry] : other.m_entries)
+            add(entry);
+    }
+
+    [[nodiscard]] size_t size() const { return m_entries.size(); }
+    [[nodiscard]] const std::unordered_map<uint32_t, LabelIndexEntry> &entries() const { return m_entries; }
+
+    /// @return the entry of the label or nullptr if the label does not occur in the volume
+    [[nodiscard]] const LabelIndexEntry *find(const uint32_t label) const {
+        const auto it = m_entries.find(label);
+        return it == m_entries.end() ? nullptr : &it->second;
+    }
+
+    /// @param merged sorted, non-overlapping intervals as returned by mergeIntervals
+    /// @return the combined entry of all labels within the intervals, with a count of 0 if there are none
+    [[nodiscard]] LabelIndexEntry select(const std::vector<Interval> &merged) const {
+        LabelIndexEntry selection;
+        for (const auto &[label, entry] : m_entries) {
+            if (intervalsContain(merged, label))
+                selection.merge(entry);
+        }
+        return selection;
+    }
+
+  private:
+    std::unordered_map<uint32_t, LabelIndexEntry> m_entries;
+};
+
+/// Builds the label index of a volume in a single parallel pass. Each worker fills a partial index for its rows,
+/// the partial indices are merged at the end.
+template <typename T>
+LabelIndex buildLabelIndex(const T *labels, const size_t (&dim)[3], const unsigned thread_count = 0u) {
+    std::vector<LabelIndex> partial(resolve_thread_count(thread_count));
+    parallel_for(dim[1] * dim[2], thread_count, [&](const size_t row, const unsigned thread_idx) {
+        partial[thread_idx].addRow(labels + row * dim[0], dim[0], 0u, static_cast<uint32_t>(row % dim[1]),
+                                   static_cast<uint32_t>(row / dim[1]));
+    });
+    LabelIndex index = std::move(partial[0]);
+    for (size_t t = 1; t < partial.size(); t++)
+        index.merge(partial[t]);
+    return index;
+}
+
+} // namespace vvv
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "parallel.hpp"
+#include "util.hpp"
+#include "VoxelRegion.hpp"
+
+namespace vvv {
+
+/// @return the most frequent of the count labels, ties are resolved in favor of the smaller label
+template <typename T>
+T majorityLabel(T (&labels)[8], const int count) {
+    // fast path for homogeneous regions
+    bool uniform = true;
+    for (int i = 1; i < count; i++)
+        uniform &= labels[i] == labels[0];
+    if (uniform)
+        return labels[0];
+
+    std::sort(labels, labels + count);
+    T best = labels[0];
+    int best_count = 0;
+    for (int i = 0; i < count;) {
+        int j = i + 1;
+        while (j < count && labels[j] == labels[i])
+            j++;
+        if (j - i > best_count) {
+            best = labels[i];
+            best_count = j - i;
+        }
+        i = j;
+    }
+    return best;
+}
+
+/// Halves the resolution of a label volume by assigning each output voxel the majority label of its (up to) 2x2x2
+/// input voxels. Unlike averaging, this never creates labels that do not exist in the input.
+/// @param dst output volume of dimensions (src_dim + 1) / 2
+template <typename T>
+void downsampleLabels(const T *src, const size_t (&src_dim)[3], T *dst, const unsigned thread_count = 0u) {
+    const size_t dst_dim[3] = {(src_dim[0] + 1u) / 2u, (src_dim[1] + 1u) / 2u, (src_dim[2] + 1u) / 2u};
+    parallel_for(dst_dim[1] * dst_dim[2], thread_count, [&](const size_t yz, unsigned) {
+        const size_t y = yz % dst_dim[1], z = yz / dst_dim[1];
+        T *dst_row = dst + yz * dst_dim[0];
+        for (size_t x = 0; x < dst_dim[0]; x++) {
+            T labels[8];
+            int count = 0;
+            for (size_t sz = 2u * z; sz < std::min(2u * z + 2u, src_dim[2]); sz++) {
+                for (size_t sy = 2u * y; sy < std::min(2u * y + 2u, src_dim[1]); sy++) {
+                    const T *src_row = src + (sz * src_dim[1] + sy) * src_dim[0];
+                    for (size_t sx = 2u * x; sx < std::min(2u * x + 2u, src_dim[0]); sx++)
+                        labels[count++] = src_row[sx];
+                }
+            }
+            dst_row[x] = majorityLabel(labels, count);
+        }
+    });
+}
+
+/// @return a new image of the given level of the label pyramid of image, where level 0 is the image itself and each
+/// level halves the resolution of the previous one. Voxel centers are placed at the center of their input voxels.
+inline vtkSmartPointer<vtkImageData> buildLabelMipLevel(vtkImageData *image, const int level, const unsigned thread_count = 0u) {
+    vtkSmartPointer<vtkImageData> current = image;
+    for (int l = 0; l < level; l++) {
+        int src_dim_int[3];
+        double spacing[3], origin[3];
+        current->GetDimensions(src_dim_int);
+        current->GetSpacing(spacing);
+        current->GetOrigin(origin);
+        const size_t src_dim[3] = {static_cast<size_t>(src_dim_int[0]), static_cast<size_t>(src_dim_int[1]),
+                                   static_cast<size_t>(src_dim_int[2])};
+
+        auto coarse = vtkSmartPointer<vtkImageData>::New();
+        coarse->SetDimensions(static_cast<int>((src_dim[0] + 1u) / 2u), static_cast<int>((src_dim[1] + 1u) / 2u),
+                              static_cast<int>((src_dim[2] + 1u) / 2u));
+        coarse->SetSpacing(2. * spacing[0], 2. * spacing[1], 2. * spacing[2]);
+        coarse->SetOrigin(origin[0] + 0.5 * spacing[0], origin[1] + 0.5 * spacing[1], origin[2] + 0.5 * spacing[2]);
+        coarse->AllocateScalars(current->GetScalarType(), 1);
+        visitLabelType(current->GetScalarType(), [&](auto label) {
+            using T = decltype(label);
+            downsampleLabels(static_cast<const T *>(current->GetScalarPointer()), src_dim,
+                             static_cast<T *>(coarse->GetScalarPointer()), thread_count);
+        });
+        current = coarse;
+    }
+    return current;
+}
+
+/// Estimates the largest on-screen size of a voxel within the region by projecting the voxel axes at the region
+/// corners and center. Returns infinity if any of these points lies behind the camera.
+/// @param voxel_to_clip transformation from voxel coordinates into clip space
+/// @return the largest voxel footprint in pixels
+inline float maxVoxelFootprint(const glm::mat4 &voxel_to_clip, const VoxelRegion &region, const int width, const int height) {
+    const auto to_pixels = [&](const glm::vec3 &p, glm::vec2 &px) {
+        const glm::vec4 c = voxel_to_clip * glm::vec4(p, 1.f);
+        if (c.w <= 0.f)
+            return false;
+        px = glm::vec2(c.x / c.w * 0.5f * static_cast<float>(width), c.y / c.w * 0.5f * static_cast<float>(height));
+        return true;
+    };
+
+    float footprint = 0.f;
+    for (int c = 0; c < 9; c++) {
+        glm::vec3 p;
+        for (int a = 0; a < 3; a++) {
+            const auto lo = static_cast<float>(region.min[a]), hi = static_cast<float>(region.max[a]) - 1.f;
+            p[a] = c == 8 ? 0.5f * (lo + hi) : ((c >> a) & 1 ? hi : lo);
+        }
+        glm::vec2 px;
+        if (!to_pixels(p, px))
+            return INFINITY;
+        for (int a = 0; a < 3; a++) {
+            glm::vec3 q = p;
+            q[a] += 1.f;
+            glm::vec2 qx;
+            if (!to_pixels(q, qx))
+                return INFINITY;
+            footprint = std::max(footprint, glm::length(qx - px));
+        }
+    }
+    return footprint;
+}
+
+/// @return the coarsest pyramid level of a volume with the given dimensions that still has more than one voxel along
+/// its largest axis
+inline int maxLabelMipLevel(const int (&dim)[3]) {
+    int level = 0;
+    for (int d = std::max({dim[0], dim[1], dim[2]}); d > 2; d = (d + 1) / 2)
+        level++;
+    return level;
+}
+
+/// @return the coarsest pyramid level in [0, max_level] at which voxels of the given footprint stay sub-pixel
+inline int selectLabelMipLevel(const float voxel_footprint, const int max_level) {
+    int level = 0;
+    while (level < max_level && voxel_footprint * static_cast<float>(2 << level) <= 1.f)
+        level++;
+    return level;
+}
+
+} // namespace vvv
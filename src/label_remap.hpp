@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "intervals.hpp"
+#include "parallel.hpp"
+
+namespace vvv {
+
+/// Compact relabeling of a segmentation volume. All labels that lie within the visible intervals are mapped to the
+/// dense labels [0, visible_count), all remaining labels to [visible_count, label_count()). Within both groups, the
+/// order of the original labels is preserved. The opacity transfer function of a remapped volume is a single step.
+struct LabelRemap {
+    std::vector<uint32_t> dense_to_label;   ///< original label of each dense label
+    uint32_t visible_count = 0u;            ///< number of dense labels that belong to a visible interval
+
+    [[nodiscard]] uint32_t label_count() const { return static_cast<uint32_t>(dense_to_label.size()); }
+    [[nodiscard]] bool empty() const { return dense_to_label.empty(); }
+
+    /// @return the original volume label of the given dense label
+    [[nodiscard]] uint32_t original(const uint32_t dense) const { return dense_to_label.at(dense); }
+};
+
+/// Creates a compact remapping that places all labels within the merged visible intervals first.
+/// @param sorted_labels sorted list of distinct labels occurring in the volume
+/// @param visible sorted and merged intervals of visible labels
+inline LabelRemap buildLabelRemap(const std::vector<uint32_t> &sorted_labels, const std::vector<Interval> &visible) {
+    LabelRemap remap;
+    remap.dense_to_label.reserve(sorted_labels.size());
+    for (const uint32_t l : sorted_labels) {
+        if (intervalsContain(visible, l))
+            remap.dense_to_label.push_back(l);
+    }
+    remap.visible_count = remap.label_count();
+    for (const uint32_t l : sorted_labels) {
+        if (!intervalsContain(visible, l))
+            remap.dense_to_label.push_back(l);
+    }
+    return remap;
+}
+
+/// Rewrites all labels of the volume data in place to their dense labels of the remapping.
+/// All labels occurring in data must be contained in the remapping.
+template <typename T>
+void applyLabelRemap(T *data, const size_t voxels, const LabelRemap &remap, const unsigned thread_count = 0u) {
+    if (remap.empty())
+        return;
+    if (remap.label_count() - 1u > std::numeric_limits<T>::max())
+        throw std::runtime_error("remapped labels do not fit into the volume label type");
+
+    // sorted original labels and the dense label of each one for binary searching
+    std::vector<uint32_t> sorted_labels(remap.dense_to_label);
+    std::vector<uint32_t> rank_to_dense(remap.label_count());
+    std::ranges::sort(sorted_labels);
+    for (uint32_t d = 0; d < remap.label_count(); d++)
+        rank_to_dense[std::ranges::lower_bound(sorted_labels, remap.dense_to_label[d]) - sorted_labels.begin()] = d;
+
+    // if the original label range is small enough, a direct lookup table replaces the binary search
+    constexpr size_t MAX_LUT_SIZE = 1u << 26;
+    const uint32_t label_min = sorted_labels.front();
+    const size_t range = static_cast<size_t>(sorted_labels.back()) - label_min + 1u;
+    std::vector<uint32_t> lut;
+    if (range <= MAX_LUT_SIZE) {
+        lut.resize(range);
+        for (size_t r = 0; r < sorted_labels.size(); r++)
+            lut[sorted_labels[r] - label_min] = rank_to_dense[r];
+    }
+
+    parallel_for_blocks(voxels, 1u << 20, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+        if (!lut.empty()) {
+            for (size_t i = begin; i < end; i++)
+                data[i] = static_cast<T>(lut[static_cast<uint32_t>(data[i]) - label_min]);
+        } else {
+            // cache the last lookup as neighboring voxels mostly share their label
+            uint32_t last_label = static_cast<uint32_t>(data[begin]);
+            T last_dense = static_cast<T>(rank_to_dense[std::ranges::lower_bound(sorted_labels, last_label) - sorted_labels.begin()]);
+            for (size_t i = begin; i < end; i++) {
+                if (static_cast<uint32_t>(data[i]) != last_label) {
+                    last_label = static_cast<uint32_t>(data[i]);
+                    last_dense = static_cast<T>(rank_to_dense[std::ranges::lower_bound(sorted_labels, last_label) - sorted_labels.begin()]);
+                }
+                data[i] = last_dense;
+            }
+        }
+    });
+}
+
+} // namespace vvv
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "parallel.hpp"
+
+namespace vvv {
+
+/// Label range, distinct label count and sparse label histogram of a segmentation volume.
+struct LabelStatistics {
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0u;
+    uint64_t voxels = 0u;
+    std::unordered_map<uint32_t, uint64_t> histogram;   ///< voxel count of each label occurring in the volume
+
+    [[nodiscard]] size_t distinct() const { return histogram.size(); }
+
+    /// Accumulates count consecutive labels.
+    template <typename T>
+    void add(const T *data, const size_t count) {
+        if (count == 0u)
+            return;
+
+        // branch free min / max reduction that the compiler can vectorize
+        T lo = data[0], hi = data[0];
+        for (size_t i = 1; i < count; i++) {
+            lo = std::min(lo, data[i]);
+            hi = std::max(hi, data[i]);
+        }
+        min = std::min(min, static_cast<uint32_t>(lo));
+        max = std::max(max, static_cast<uint32_t>(hi));
+        voxels += count;
+
+        // neighboring voxels mostly share their label: only update the histogram at the end of each run
+        T run_label = data[0];
+        uint64_t run_length = 1u;
+        for (size_t i = 1; i < count; i++) {
+            if (data[i] == run_label) {
+                run_length++;
+            } else {
+                histogram[static_cast<uint32_t>(run_label)] += run_length;
+                run_label = data[i];
+                run_length = 1u;
+            }
+        }
+        histogram[static_cast<uint32_t>(run_label)] += run_length;
+    }
+
+    void merge(const LabelStatistics &other) {
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        voxels += other.voxels;
+        for (const auto &[label, count] : other.histogram)
+            histogram[label] += count;
+    }
+
+    /// @return all labels occurring in the volume in ascending order
+    [[nodiscard]] std::vector<uint32_t> sortedLabels() const {
+        std::vector<uint32_t> labels;
+        labels.reserve(histogram.size());
+        for (const auto &[label, count] : histogram)
+            labels.push_back(label);
+        std::ranges::sort(labels);
+        return labels;
+    }
+
+    /// @return up to n (label, voxel count) pairs with the highest voxel counts in descending order
+    [[nodiscard]] std::vector<std::pair<uint32_t, uint64_t>> largestLabels(const size_t n) const {
+        std::vector<std::pair<uint32_t, uint64_t>> labels(histogram.begin(), histogram.end());
+        const auto end = labels.begin() + static_cast<std::ptrdiff_t>(std::min(n, labels.size()));
+        std::partial_sort(labels.begin(), end, labels.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+        labels.erase(end, labels.end());
+        return labels;
+    }
+};
+
+/// Collects label statistics from multiple threads into separate partial results that are merged once at the end.
+/// The accumulator can be passed as row visitor to read_hdf5_chunked to compute statistics while data is in cache.
+class LabelStatisticsAccumulator {
+  public:
+    explicit LabelStatisticsAccumulator(const unsigned thread_count = 0u) : m_partial(resolve_thread_count(thread_count)) {}
+
+    template <typename T>
+    void operator()(const unsigned thread_idx, const T *data, const size_t count) {
+        m_partial.at(thread_idx).add(data, count);
+    }
+
+    [[nodiscard]] LabelStatistics result() {
+        LabelStatistics stats;
+        for (const auto &p : m_partial)
+            stats.merge(p);
+        return stats;
+    }
+
+  private:
+    std::vector<LabelStatistics> m_partial;
+};
+
+/// Computes the label statistics of the volume data in a single parallel pass.
+template <typename T>
+LabelStatistics computeLabelStatistics(const T *data, const size_t voxels, const unsigned thread_count = 0u) {
+    LabelStatisticsAccumulator accumulator(thread_count);
+    parallel_for_blocks(voxels, 1u << 20, thread_count, [&](const size_t begin, const size_t end, const unsigned t) {
+        accumulator(t, data + begin, end - begin);
+    });
+    return accumulator.result();
+}
+
+} // namespace vvv
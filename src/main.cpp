@@ -10,28 +10,54 @@
 #include <vtkPiecewiseFunction.h>
 #include <vtkVolumeProperty.h>
 #include <vtkTransform.h>
+#include <vtkFixedPointVolumeRayCastMapper.h>
 #include <vtkGPUVolumeRayCastMapper.h>
 #include <vtkOpenGLGPUVolumeRayCastMapper.h>
+#include <vtkSmartVolumeMapper.h>
 #include <vtkVersion.h>
 #include <vtkVolume.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
+#include "BrickedVolume.hpp"
+#include "CameraPath.hpp"
+#include "FirstHitRayCaster.hpp"
+#include "LabelAttributes.hpp"
+#include "label_bounds.hpp"
+#include "label_colors.hpp"
+#include "label_index.hpp"
+#include "label_pyramid.hpp"
+#include "label_remap.hpp"
+#include "label_stats.hpp"
 #include "read_hdf5.hpp"
+#include "read_nrrd.hpp"
 #include "read_vcfg_tf.hpp"
+#include "RenderServer.hpp"
+#include "SharedVolume.hpp"
+#include "VolumeCache.hpp"
 #include "util.hpp"
+#include "ViewFrustum.hpp"
 #include "MiniTimer.hpp"
 
 #include "args.hpp"
 
-int main(int argc, char* argv[])
+/// Imports the volume and renders it as configured by the command line arguments.
+/// @return the exit code of the program
+static int run(int argc, char* argv[])
 {
     // PARSE ARGUMENTS
     const Config config = parseConfig(argc, argv);
     if (config.exit_with_data_count)
         return DATA_SET_COUNT;
+    // --serve - answers requests on stdout, all other output is logged to stderr instead
+    std::streambuf* const stdout_buffer = std::cout.rdbuf();
+    if (config.serve_socket == "-")
+        std::cout.rdbuf(std::cerr.rdbuf());
 
     DataSet dataSet = config.data_set;
     if (!std::filesystem::exists(getDataInputPath(config, dataSet)))
@@ -49,6 +75,8 @@ int main(int argc, char* argv[])
 
 
     std::cout << "Rendering segmentation volume '" << getDataOutputName(config.data_set) << "'" << std::endl;
+    if (config.out_of_core)
+        std::cout << "Reading the volume out-of-core with a memory budget of " << config.memory_budget_gb << " GB" << std::endl;
     std::cout << "VTK Version: " << vtkVersion::GetVTKVersion() << std::endl;
 
     // SETUP -----------------------------------------------------------------------------------------------------------
@@ -59,107 +87,632 @@ int main(int argc, char* argv[])
     // load Volcanite configuration file (.vcfg) for importing translatebale parameters
     // note: this is all hardcoded for version 0.6.0
     VolcaniteParameters params = VcfgSegVolTFFileReader::readParameterFile(getVcfgPath(config, dataSet));;
+    // camera path that moves the camera in every frame, starting at the .vcfg camera
+    std::optional<vvv::CameraPath> cameraPath;
+    if (config.camera_path == "orbit")
+        cameraPath = vvv::CameraPath::orbit(params.camera);
+    else if (config.camera_path == "dolly")
+        cameraPath = vvv::CameraPath::dolly(params.camera);
+    else if (config.camera_path == "flythrough")
+        cameraPath = vvv::CameraPath::flyThrough(vvv::CameraPath::readKeyframes(config.camera_keyframes_file.value().string()));
+    const auto pathCamera = [&](const int frame) {
+        const int steps = cameraPath->closed() ? config.render_frames : std::max(config.render_frames - 1, 1);
+        return cameraPath->at(static_cast<float>(frame) / static_cast<float>(steps));
+    };
+    // imported, listed, orbit and served views may look anywhere: the working set and the level of detail are then
+    // not selected for the .vcfg camera but cover the whole volume at full resolution
+    const bool any_view = (!cameraPath && !config.camera_import_file.empty()) || config.camera_list_file.has_value()
+                          || config.orbit_views > 0 || config.serve_socket.has_value();
+    // views that select the working set and the level of detail: the .vcfg camera or all frames of the camera path
+    std::vector<vvv::Camera> planned_views;
+    if (!any_view && cameraPath) {
+        for (int frame = 0; frame < std::max(config.render_frames, 1); frame++)
+            planned_views.push_back(pathCamera(frame));
+    } else if (!any_view) {
+        planned_views.push_back(params.camera);
+    }
+    const auto plannedVoxelToClip = [&](const double (&bounds)[6]) {
+        std::vector<glm::mat4> voxel_to_clip;
+        for (const auto& view : planned_views)
+            voxel_to_clip.push_back(params.voxel_to_clip_space(
+                bounds, static_cast<float>(config.render_width) / static_cast<float>(config.render_height), view));
+        return voxel_to_clip;
+    };
 
     // RENDERING OBJECTS
-    // use GPU ray casting for volume rendering
-    const vtkSmartPointer<vtkOpenGLGPUVolumeRayCastMapper> volumeMapper = vtkSmartPointer<vtkOpenGLGPUVolumeRayCastMapper>::New();
+    // VTK volume mapper of the selected backend. The CPU first-hit ray caster renders on its own and only takes the
+    // input image and cropping from the (never rendering) GPU mapper.
+    vtkSmartPointer<vtkVolumeMapper> volumeMapper;
+    switch (config.renderer)
+    {
+    case CPU_FIXED_POINT:
+    {
+        const auto fixedPointMapper = vtkSmartPointer<vtkFixedPointVolumeRayCastMapper>::New();
+        fixedPointMapper->SetNumberOfThreads(static_cast<int>(vvv::resolve_thread_count(config.thread_count)));
+        // render every pixel with a fixed sample distance as the GPU ray caster does
+        fixedPointMapper->SetAutoAdjustSampleDistances(false);
+        fixedPointMapper->SetImageSampleDistance(1.f);
+        volumeMapper = fixedPointMapper;
+        break;
+    }
+    case SMART:
+    {
+        const auto smartMapper = vtkSmartPointer<vtkSmartVolumeMapper>::New();
+        smartMapper->SetRequestedRenderModeToDefault();
+        smartMapper->SetAutoAdjustSampleDistances(false);
+        volumeMapper = smartMapper;
+        break;
+    }
+    default:
+        volumeMapper = vtkSmartPointer<vtkOpenGLGPUVolumeRayCastMapper>::New();
+        break;
+    }
     const vtkSmartPointer<vtkColorTransferFunction> colorTF = vtkSmartPointer<vtkColorTransferFunction>::New();
     const vtkSmartPointer<vtkPiecewiseFunction> opacityTF = vtkSmartPointer<vtkPiecewiseFunction>::New();
 
+    // merge volcanite label intervals from visible materials
+    std::vector<Interval> intervals;
+    // material of each label in the attribute table (empty if materials discriminate label ids only)
+    std::vector<uint8_t> label_materials;
+    // rendered materials: all materials initially, --serve requests may select a subset
+    std::vector<uint8_t> material_selection(params.materials.size(), 1u);
+    // merged intervals of the original labels of the selected visible materials, overlapping label ranges belong to
+    // the first material as in the material volume
+    const auto selectedMaterialIntervals = [&](const std::vector<uint8_t>& selection) {
+        if (config.attribute_file.has_value())
+            return vvv::materialLabelIntervals(params.materials, label_materials, selection);
+        return vvv::materialLabelRanges(params.materials, selection, 0u, true);
+    };
+    // merged material volume indices m + 1 of the selected visible materials
+    const auto selectedMaterialIndices = [&](const std::vector<uint8_t>& selection) {
+        std::vector<Interval> selected;
+        for (uint32_t m = 0; m < params.materials.size(); m++)
+            if (selection[m] && vvv::materialVisible(params.materials[m]))
+                selected.push_back({m + 1u, m + 1u});
+        return mergeIntervals(selected);
+    };
+    if (config.attribute_file.has_value()) {
+        MiniTimer attribute_timer;
+        const vvv::LabelAttributes attributes = vvv::LabelAttributes::read(config.attribute_file.value());
+        label_materials = vvv::classifyLabelMaterials(params.materials, attributes, config.thread_count);
+        std::cout << "Classified " << attributes.labelCount() << " labels by " << attributes.attributeCount() - 1
+                  << " attributes in " << attribute_timer.elapsed() << " s" << std::endl;
+    } else {
+        for (const auto& m : params.materials) {
+            if (m.discrAttribute != SegmentedVolumeMaterial::DISCR_NONE && !vvv::discriminatesLabel(m))
+                std::cout << "Material attribute " << m.discrAttribute << " requires --attributes, "
+                          << "using its interval as label range" << std::endl;
+        }
+    }
+    intervals = selectedMaterialIntervals(material_selection);
+    if (config.verbose)
+    {
+        std::cout << "Merged transfer function intervals:" << std::endl;
+        for (const auto& i : intervals) {
+            std::cout << "  [" << i.start << "," << i.end << "]" << std::endl;
+        }
+    }
+
     // VOLUME IMPORT
     double timer_io_s = 0.;
     double time_to_first_frame_s = 0;
     MiniTimer timer;
     uint32_t label_min = UINT32_MAX, label_max = 0u;
+    vvv::Hdf5ReadInfo read_info = {};
+    // bounds of the complete volume in VTK world space, even if only a region of interest is loaded
+    double volume_bounds[6];
+    // dense relabeling of the volume, keeps the original label of each dense label (empty if labels are not remapped)
+    vvv::LabelRemap label_remap;
+    // intervals of the labels that are visible in the rendered image, refer to dense labels if labels are remapped
+    std::vector<Interval> visible_intervals;
+    // world space bounds of the rendered voxels, only smaller than volume_bounds if the image is cropped
+    double visible_bounds[6];
+    // range, distinct label count and histogram of the original volume labels
+    vvv::LabelStatistics label_stats;
+    // memory mapped cache entry that provides the volume labels if it was found in the cache, must outlive the image
+    std::unique_ptr<vvv::MappedVolumeCacheEntry> cached_volume;
+    double time_cache_store_s = 0.;
+    // memory mapped raw volume file that provides the volume labels of .nhdr / .nrrd volumes, must outlive the image
+    std::unique_ptr<vvv::MappedFile> mapped_volume_file;
+    // out-of-core volume whose brick cache is kept for the lifetime of the renderer
+    std::unique_ptr<vvv::BrickedVolume> bricked_volume;
+    // rendered level of the label pyramid, each level halves the resolution of the imported volume
+    int lod_level = 0;
+    const std::filesystem::path volume_file = getDataInputPath(config, dataSet);
+    const bool is_hdf5 = volume_file.extension() == ".hdf5" || volume_file.extension() == ".h5";
+    // the region of interest is only read from .hdf5 files, other formats are always imported completely
+    const vvv::VoxelRegion requested_region = (config.load_roi && is_hdf5) ? params.split_plane_region() : vvv::VoxelRegion{};
+
+    // attach to the preprocessed volume of a concurrent run with the same volume and parameters if one is published
+    std::optional<vvv::SharedVolumeStore> shared_volume_store;
+    uint64_t shared_volume_key = 0u;
+    // read-only shared mapping that provides the preprocessed labels if it was attached, must outlive the image
+    std::unique_ptr<vvv::SharedVolume> shared_volume;
+    if (config.shared_volume_dir.has_value()) {
+        shared_volume_store.emplace(config.shared_volume_dir.value());
+        // all parameters of the preprocessing below that change the labels or the restored state
+        std::ostringstream preprocessing;
+        preprocessing << config.remap_labels << config.material_volume << config.tight_crop << any_view << config.lod_level << " "
+                      << params.split_plane_x[0] << " " << params.split_plane_x[1] << " " << params.split_plane_y[0] << " "
+                      << params.split_plane_y[1] << " " << params.split_plane_z[0] << " " << params.split_plane_z[1];
+        if (!any_view && (config.lod_level < 0 || config.out_of_core)) {
+            preprocessing << " " << config.render_width << "x" << config.render_height << " ";
+            for (vvv::Camera view : planned_views)
+                view.writeTo(preprocessing, true);
+        }
+        for (const auto& i : intervals)
+            preprocessing << " " << i.start << "-" << i.end;
+        // material volumes store the first enabled material of each label, which the merged intervals do not capture
+        if (config.material_volume) {
+            preprocessing << " " << params.materials.size() << std::setprecision(9);
+            for (const auto& m : params.materials)
+                preprocessing << " " << m.discrAttribute << ":" << m.discrInterval[0] << "-" << m.discrInterval[1] << ":"
+                              << m.opacity;
+        }
+        preprocessing.write(reinterpret_cast<const char*>(label_materials.data()), static_cast<std::streamsize>(label_materials.size()));
+        shared_volume_key = vvv::SharedVolumeStore::key(
+            vvv::VolumeCacheKey::of(volume_file, requested_region, params.axis_scale).hash(), preprocessing.str());
+        shared_volume = shared_volume_store->attach(shared_volume_key, config.verify_shared_volume, config.thread_count);
+    }
+
+    if (shared_volume)
     {
-        const std::filesystem::path volume_file = getDataInputPath(config, dataSet);
+        const vtkSmartPointer<vtkImageData> image = shared_volume->createImage();
+        const vvv::PreprocessedVolumeState state = shared_volume->state();
+        std::copy_n(state.volume_bounds, 6, volume_bounds);
+        std::copy_n(state.visible_bounds, 6, visible_bounds);
+        label_min = state.label_min;
+        label_max = state.label_max;
+        lod_level = state.lod_level;
+        intervals = state.intervals;
+        visible_intervals = state.visible_intervals;
+        label_remap = state.label_remap;
+        int dim[3];
+        image->GetDimensions(dim);
+        std::cout << "Attached shared volume " << shared_volume->path() << " [" << dim[0] << "," << dim[1] << ","
+                  << dim[2] << "] " << image->GetScalarTypeAsString() << ", labels [" << label_min << "," << label_max
+                  << "]" << std::endl;
+        volumeMapper->SetInputData(image);
+        volumeMapper->Update();
+    }
+    else
+    {
+        // look up the imported volume in the cache first
+        std::optional<vvv::VolumeCache> volume_cache;
+        vvv::VolumeCacheKey cache_key;
+        if (config.cache_dir.has_value() && !config.out_of_core) {
+            volume_cache.emplace(config.cache_dir.value());
+            cache_key = vvv::VolumeCacheKey::of(volume_file, requested_region, params.axis_scale);
+            cached_volume = volume_cache->load(cache_key);
+        }
 
         // load volume from disk, compute min/max volume labels, and assign to VolumeMapper
-        if (volume_file.extension() == ".vti") {
+        vtkSmartPointer<vtkImageData> image;
+        if (cached_volume) {
+            image = cached_volume->createImage();
+            std::copy_n(cached_volume->header().volume_bounds, 6, volume_bounds);
+            label_stats = cached_volume->statistics();
+            std::cout << "Mapped cached volume " << volume_cache->file(cache_key) << std::endl;
+        } else if (volume_file.extension() == ".vti") {
             const vtkSmartPointer<vtkXMLImageDataReader> reader = vtkSmartPointer<vtkXMLImageDataReader>::New();
             reader->SetFileName(volume_file.c_str());
             reader->Update();
 
-            volumeMapper->SetInputConnection(reader->GetOutputPort());
+            image = reader->GetOutput();
+            image->GetBounds(volume_bounds);
+        } else if (volume_file.extension() == ".nhdr" || volume_file.extension() == ".nrrd") {
+            // raw labels are mapped directly as image scalars if their layout matches
+            const double default_spacing[3] = {params.axis_scale[0], params.axis_scale[1], params.axis_scale[2]};
+            vvv::RawVolume raw = vvv::read_nrrd(volume_file, default_spacing, config.thread_count);
+            image = raw.image;
+            mapped_volume_file = std::move(raw.mapping);
+            image->GetBounds(volume_bounds);
+            std::cout << (mapped_volume_file ? "Mapped" : "Converted") << " raw labels of " << volume_file << std::endl;
+        } else if (is_hdf5 && config.out_of_core) {
+            bricked_volume = std::make_unique<vvv::BrickedVolume>(volume_file, config.brick_size,
+                                                                  static_cast<size_t>(config.memory_budget_gb * 1.e9),
+                                                                  config.thread_count);
+            const auto& dimensions = bricked_volume->dimensions();
+            for (int a = 0; a < 3; a++) {
+                volume_bounds[2 * a] = 0.;
+                volume_bounds[2 * a + 1] = static_cast<double>(dimensions[a] - 1) * params.axis_scale[a];
+            }
 
-            double range[2];
-            reader->GetOutput()->GetScalarRange(range);
-            label_min = static_cast<uint32_t>(range[0]);
-            label_max = static_cast<uint32_t>(range[1]);
-        } else if (volume_file.extension() == ".hdf5" || volume_file.extension() == ".h5") {
-            size_t dimensions[3];
+            // working set: bricks within the split planes that intersect the view frustum of any planned view
+            std::vector<vvv::ViewFrustum> frusta;
+            for (const glm::mat4& voxel_to_clip : plannedVoxelToClip(volume_bounds))
+                frusta.push_back({voxel_to_clip});
+            const std::vector<size_t> working_set = bricked_volume->bricksWhere(
+                params.split_plane_region(), [&](const vvv::VoxelRegion& brick) {
+                    return frusta.empty()
+                           || std::ranges::any_of(frusta, [&](const vvv::ViewFrustum& f) { return f.intersects(brick); });
+                });
 
+            // bricks are read straight into the image so that only the image has to fit into the memory budget
+            vvv::VoxelRegion region;
+            image = bricked_volume->assemble(working_set, region);
+            image->SetSpacing(params.axis_scale[0], params.axis_scale[1], params.axis_scale[2]);
+            image->SetOrigin(static_cast<double>(region.min[0]) * params.axis_scale[0],
+                             static_cast<double>(region.min[1]) * params.axis_scale[1],
+                             static_cast<double>(region.min[2]) * params.axis_scale[2]);
+
+            const auto& brick_stats = bricked_volume->statistics();
+            read_info.bytes = brick_stats.bytes_read;
+            read_info.chunks = brick_stats.misses;
+            read_info.seconds = brick_stats.read_seconds;
+            read_info.threads = vvv::resolve_thread_count(config.thread_count);
+            std::cout << "Read " << working_set.size() << " of " << bricked_volume->brickCount() << " bricks ("
+                      << static_cast<double>(brick_stats.bytes_read) * 1.e-9 << " GB) in " << brick_stats.read_seconds
+                      << " s, assembled region " << region << std::endl;
+        } else if (is_hdf5) {
             // obtain volume dimensions from file, allocate memory
-            const vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
-            vvv::read_hdf5<uint32_t>(volume_file, dimensions);
-            image->SetDimensions(static_cast<int>(dimensions[0]),
-                                 static_cast<int>(dimensions[1]),
-                                 static_cast<int>(dimensions[2]));
-            image->AllocateScalars(VTK_UNSIGNED_INT, 1);
+            const vvv::Hdf5Volume hdf5_volume(volume_file);
+            const auto& dimensions = hdf5_volume.dimensions();
+            image = vtkSmartPointer<vtkImageData>::New();
+            for (int a = 0; a < 3; a++) {
+                volume_bounds[2 * a] = 0.;
+                volume_bounds[2 * a + 1] = static_cast<double>(dimensions[a] - 1) * params.axis_scale[a];
+            }
+
+            // only read the region within the split planes if requested, placing it at its original position
+            vvv::VoxelRegion region = vvv::VoxelRegion::full(dimensions);
+            if (config.load_roi) {
+                region = requested_region.clamped(dimensions);
+                if (region.empty())
+                    throw std::runtime_error("split planes do not contain any voxels of the volume");
+                std::cout << "Reading region of interest " << region << " ("
+                          << 100. * static_cast<double>(region.voxels()) / static_cast<double>(vvv::VoxelRegion::full(dimensions).voxels())
+                          << "% of all voxels)" << std::endl;
+            }
+            image->SetDimensions(static_cast<int>(region.extent(0)),
+                                 static_cast<int>(region.extent(1)),
+                                 static_cast<int>(region.extent(2)));
+            // store labels in their native bit width (at most 32 bit), wider labels are narrowed while reading
+            const int label_type = labelTypeForBytes(hdf5_volume.labelBytes());
+            image->AllocateScalars(label_type, 1);
             image->SetSpacing(params.axis_scale[0], params.axis_scale[1], params.axis_scale[2]);
-            vvv::read_hdf5<uint32_t>(volume_file, dimensions, static_cast<uint32_t*>(image->GetScalarPointer()));
-            volumeMapper->SetInputData(image);
-            volumeMapper->Update();
+            image->SetOrigin(static_cast<double>(region.min[0]) * params.axis_scale[0],
+                             static_cast<double>(region.min[1]) * params.axis_scale[1],
+                             static_cast<double>(region.min[2]) * params.axis_scale[2]);
+            // label statistics are accumulated per chunk while reading
+            vvv::LabelStatisticsAccumulator stats_accumulator(config.thread_count);
+            visitLabelType(label_type, [&](auto label) {
+                using T = decltype(label);
+                read_info = hdf5_volume.read<T>(static_cast<T*>(image->GetScalarPointer()), config.thread_count, region,
+                                                stats_accumulator);
+            });
+            label_stats = stats_accumulator.result();
+            std::cout << "Read " << static_cast<double>(read_info.bytes) * 1.e-9 << " GB from " << read_info.chunks
+                      << (read_info.parallel ? " chunks" : " slabs") << " in " << read_info.seconds << " s using "
+                      << read_info.threads << " thread(s): " << read_info.gb_per_s() << " GB/s ("
+                      << read_info.gb_per_s() / read_info.threads << " GB/s per thread)" << std::endl;
+        } else if (volume_file.extension() == ".csgv") {
+            // TODO: decode Volcanite compressed segmentation volumes (brick-wise, in parallel) instead of requiring an export
+            throw std::runtime_error("Volcanite .csgv volumes can not be decoded yet, export " + volume_file.string()
+                                     + " as .hdf5 or raw .nhdr volume and pass it with --volume-file");
+        } else {
+            throw std::runtime_error("unsupported segmentation volume file extension " + volume_file.extension().string());
+        }
 
-            double range[2];
-            image->GetScalarRange(range);
-            label_min = static_cast<uint32_t>(range[0]);
-            label_max = static_cast<uint32_t>(range[1]);
+        // formats without a fused statistics pass are analyzed after the import
+        if (label_stats.voxels == 0u) {
+            visitLabelType(image->GetScalarType(), [&](auto label) {
+                using T = decltype(label);
+                label_stats = vvv::computeLabelStatistics(static_cast<const T*>(image->GetScalarPointer()),
+                                                          static_cast<size_t>(image->GetNumberOfPoints()), config.thread_count);
+            });
         }
+
+        // store the imported labels before any preprocessing that depends on the .vcfg parameters
+        if (volume_cache.has_value() && !cached_volume) {
+            MiniTimer store_timer;
+            if (volume_cache->store(cache_key, image, volume_bounds, label_stats))
+                std::cout << "Wrote volume cache " << volume_cache->file(cache_key) << std::endl;
+            else
+                std::cerr << "Could not write volume cache " << volume_cache->file(cache_key) << std::endl;
+            time_cache_store_s = store_timer.elapsed();
+        }
+
+        label_min = label_stats.min;
+        label_max = label_stats.max;
         std::cout << "Imported segmentation volume from file " << volume_file << std::endl;
         if (config.verbose)
         {
-            std::cout << "  labels: [" << label_min << "," << label_max << "]" << std::endl;
+            std::cout << "  labels: [" << label_min << "," << label_max << "], " << label_stats.distinct() << " distinct" << std::endl;
+            std::cout << "  largest labels:";
+            for (const auto& [label, count] : label_stats.largestLabels(5))
+                std::cout << " " << label << " (" << 100. * static_cast<double>(count) / static_cast<double>(label_stats.voxels) << "%)";
+            std::cout << std::endl;
         }
-    }
-    timer_io_s = timer.elapsed();
 
-    // TRANSFER FUNCTION CREATION
-    {
-        // merge volcanite label intervals from visible materials
-        std::vector<Interval> intervals;
-        for (const auto& m : params.materials) {
-            if (m.discrAttribute != SegmentedVolumeMaterial::DISCR_NONE) {
-                intervals.emplace_back(m.discrInterval[0], m.discrInterval[1]);
+        // per-label voxel counts, bounds and centroids of the imported labels, reused from the cache if possible
+        std::optional<vvv::LabelIndex> label_index;
+        if (config.label_index) {
+            MiniTimer index_timer;
+            if (volume_cache.has_value())
+                label_index = volume_cache->loadLabelIndex(cache_key);
+            if (label_index) {
+                std::cout << "Loaded label index " << volume_cache->indexFile(cache_key) << std::endl;
+            } else {
+                int dim_int[3];
+                image->GetDimensions(dim_int);
+                const size_t dim[3] = {static_cast<size_t>(dim_int[0]), static_cast<size_t>(dim_int[1]),
+                                       static_cast<size_t>(dim_int[2])};
+                visitLabelType(image->GetScalarType(), [&](auto label) {
+                    using T = decltype(label);
+                    label_index = vvv::buildLabelIndex(static_cast<const T*>(image->GetScalarPointer()), dim, config.thread_count);
+                });
+                std::cout << "Built label index of " << label_index->size() << " labels in " << index_timer.elapsed() << " s" << std::endl;
+                if (volume_cache.has_value()) {
+                    MiniTimer store_timer;
+                    if (!volume_cache->storeLabelIndex(cache_key, *label_index))
+                        std::cerr << "Could not write label index " << volume_cache->indexFile(cache_key) << std::endl;
+                    time_cache_store_s += store_timer.elapsed();
+                }
+            }
+            if (config.verbose) {
+                std::cout << "  material bounds:" << std::endl;
+                for (size_t m = 0; m < params.materials.size(); m++) {
+                    const auto& material = params.materials[m];
+                    if (material.discrAttribute == SegmentedVolumeMaterial::DISCR_NONE)
+                        continue;
+                    const vvv::LabelIndexEntry selection = label_index->select(
+                        label_materials.empty()
+                            ? std::vector<Interval>{{static_cast<uint32_t>(material.discrInterval[0]),
+                                                     static_cast<uint32_t>(material.discrInterval[1])}}
+                            : vvv::materialLabelIntervals(params.materials, label_materials, static_cast<int>(m)));
+                    std::cout << "    " << m << ": " << selection.count << " voxels";
+                    if (selection.count > 0u) {
+                        const glm::dvec3 centroid = selection.centroid();
+                        std::cout << " in " << selection.region() << ", centroid (" << centroid.x << "," << centroid.y
+                                  << "," << centroid.z << ")";
+                    }
+                    std::cout << std::endl;
+                }
             }
         }
-        intervals = mergeIntervals(intervals);
-        if (config.verbose)
-        {
-            std::cout << "Merged transfer function intervals:" << std::endl;
-            for (const auto& i : intervals) {
-                std::cout << "  [" << i.start << "," << i.end << "]" << std::endl;
+
+        // optionally relabel the volume densely with the visible labels first so that the opacity TF is a single step
+        if (config.remap_labels) {
+            visitLabelType(image->GetScalarType(), [&](auto label) {
+                using T = decltype(label);
+                T* labels = static_cast<T*>(image->GetScalarPointer());
+                const auto voxels = static_cast<size_t>(image->GetNumberOfPoints());
+                label_remap = vvv::buildLabelRemap(label_stats.sortedLabels(), intervals);
+                vvv::applyLabelRemap(labels, voxels, label_remap, config.thread_count);
+            });
+            image->GetPointData()->GetScalars()->Modified();
+            label_min = 0u;
+            label_max = label_remap.label_count() - 1u;
+            std::cout << "Remapped " << label_remap.label_count() << " labels to [0," << label_max << "], "
+                      << label_remap.visible_count << " of them visible" << std::endl;
+        }
+
+        if (config.material_volume) {
+            // replace labels by 8 bit material indices: 0 for labels without material, m + 1 for material m
+            if (params.materials.size() >= vvv::NO_MATERIAL)
+                throw std::runtime_error("material volumes support at most " + std::to_string(vvv::NO_MATERIAL - 1) + " materials");
+            MiniTimer material_timer;
+            const auto bytes = static_cast<size_t>(image->GetNumberOfPoints()) * image->GetScalarSize();
+            classifyLabelScalars(image, [&](const uint32_t l) {
+                const uint8_t m = vvv::labelMaterial(params.materials, label_materials,
+                                                     label_remap.empty() ? l : label_remap.original(l));
+                return static_cast<uint8_t>(m == vvv::NO_MATERIAL ? 0u : m + 1u);
+            }, config.thread_count);
+            label_min = 0u;
+            label_max = static_cast<uint32_t>(params.materials.size());
+            std::cout << "Classified labels into a material volume in " << material_timer.elapsed() << " s ("
+                      << static_cast<double>(bytes) * 1.e-9 << " GB to "
+                      << static_cast<double>(image->GetNumberOfPoints()) * 1.e-9 << " GB)" << std::endl;
+        } else if (narrowLabelScalars(image, label_max, config.thread_count) && config.verbose) {
+            // use the smallest label type that fits all labels to save host and GPU texture memory
+            std::cout << "  narrowed labels to " << image->GetScalarTypeAsString() << std::endl;
+        }
+
+        visible_intervals = intervals;
+        if (config.material_volume)
+            visible_intervals = selectedMaterialIndices(material_selection);
+        else if (!label_remap.empty())
+            visible_intervals = label_remap.visible_count > 0u ? std::vector<Interval>{{0u, label_remap.visible_count - 1u}}
+                                                               : std::vector<Interval>{};
+        std::copy_n(volume_bounds, 6, visible_bounds);
+
+        // optionally crop the image to the bounding box of all visible voxels within the split planes
+        if (config.tight_crop) {
+            MiniTimer crop_timer;
+            const vvv::VoxelRegion image_region = imageVoxelRegion(image, volume_bounds);
+            vvv::VoxelRegion within = image_region.intersect(params.split_plane_region());
+            for (int a = 0; a < 3; a++) {
+                // convert to image voxel coordinates, split planes before the image yield an empty region
+                within.min[a] = within.min[a] > image_region.min[a] ? within.min[a] - image_region.min[a] : 0u;
+                within.max[a] = within.max[a] > image_region.min[a] ? within.max[a] - image_region.min[a] : 0u;
             }
+            int image_dim_int[3];
+            image->GetDimensions(image_dim_int);
+            const size_t image_dim[3] = {static_cast<size_t>(image_dim_int[0]), static_cast<size_t>(image_dim_int[1]),
+                                         static_cast<size_t>(image_dim_int[2])};
+            vvv::VoxelRegion visible_region;
+            if (label_index && within.covers(image_dim)) {
+                // without split planes, the bounds of the visible labels are found in the label index
+                const vvv::LabelIndexEntry selection = label_index->select(intervals);
+                visible_region = selection.count > 0u ? selection.region() : vvv::VoxelRegion::full({0u, 0u, 0u});
+            } else {
+                visitLabelType(image->GetScalarType(), [&](auto label) {
+                    using T = decltype(label);
+                    visible_region = vvv::visibleLabelRegion(static_cast<const T*>(image->GetScalarPointer()), image_dim,
+                                                             [&](const uint32_t l) { return intervalsContain(visible_intervals, l); },
+                                                             within, config.thread_count);
+                });
+            }
+            if (visible_region.empty()) {
+                std::cout << "No visible labels within the split planes, image is not cropped" << std::endl;
+            } else if (!visible_region.covers(image_dim)) {
+                image = cropLabelImage(image, visible_region, config.thread_count);
+                image->GetBounds(visible_bounds);
+                std::cout << "Cropped image to visible labels " << visible_region << " ("
+                          << 100. * static_cast<double>(visible_region.voxels()) / static_cast<double>(vvv::VoxelRegion::full(image_dim).voxels())
+                          << "% of all voxels) in " << crop_timer.elapsed() << " s" << std::endl;
+            }
+        }
+
+        // render a coarser level of the label pyramid if voxels would be sub-pixel on screen anyway
+        int image_dim[3];
+        image->GetDimensions(image_dim);
+        const int max_lod_level = vvv::maxLabelMipLevel(image_dim);
+        if (config.lod_level < 0 && any_view) {
+            std::cout << "Automatic level of detail is disabled for imported, batch or served views, rendering full resolution" << std::endl;
+        } else if (config.lod_level < 0) {
+            // voxel region of the image within the split planes
+            const vvv::VoxelRegion region = imageVoxelRegion(image, volume_bounds).intersect(params.split_plane_region());
+            if (!region.empty()) {
+                // the level must resolve the closest frame of a camera path
+                float footprint = 0.f;
+                for (const glm::mat4& voxel_to_clip : plannedVoxelToClip(volume_bounds))
+                    footprint = std::max(footprint, vvv::maxVoxelFootprint(voxel_to_clip, region, config.render_width, config.render_height));
+                lod_level = vvv::selectLabelMipLevel(footprint, max_lod_level);
+                if (config.verbose)
+                    std::cout << "  largest voxel footprint: " << footprint << " px" << std::endl;
+            }
+        } else {
+            lod_level = std::min(config.lod_level, max_lod_level);
+        }
+        if (lod_level > 0) {
+            MiniTimer lod_timer;
+            image = vvv::buildLabelMipLevel(image, lod_level, config.thread_count);
+            int lod_dim[3];
+            image->GetDimensions(lod_dim);
+            std::cout << "Downsampled labels to pyramid level " << lod_level << " [" << lod_dim[0] << "," << lod_dim[1]
+                      << "," << lod_dim[2] << "] in " << lod_timer.elapsed() << " s" << std::endl;
+        }
+
+        // publish the preprocessed labels for concurrent runs, writing them is not part of the import
+        if (shared_volume_store.has_value()) {
+            MiniTimer publish_timer;
+            vvv::PreprocessedVolumeState state;
+            std::copy_n(volume_bounds, 6, state.volume_bounds);
+            std::copy_n(visible_bounds, 6, state.visible_bounds);
+            state.label_min = label_min;
+            state.label_max = label_max;
+            state.lod_level = lod_level;
+            state.intervals = intervals;
+            state.visible_intervals = visible_intervals;
+            state.label_remap = label_remap;
+            if (shared_volume_store->publish(shared_volume_key, image, state, config.thread_count))
+                std::cout << "Published shared volume " << shared_volume_store->file(shared_volume_key) << std::endl;
+            else
+                std::cerr << "Could not publish shared volume " << shared_volume_store->file(shared_volume_key) << std::endl;
+            time_cache_store_s += publish_timer.elapsed();
         }
+        volumeMapper->SetInputData(image);
+        volumeMapper->Update();
+    }
+    // writing the cache is a one time cost that is not part of the import
+    timer_io_s = timer.elapsed() - time_cache_store_s;
 
-        // Set up a single VTK color and opacity transfer function from the merged intervals
-        const int COLOR_TF_SIZE = glm::min(256u, label_max);
-        for (unsigned int x = 0; x < COLOR_TF_SIZE; x++)
-            colorTF->AddHSVPoint(static_cast<double>(x) * ((label_max + 1) / static_cast<double>(COLOR_TF_SIZE)),
-                                 static_cast<double>(pcg_hash(x) % 512u) / 512.,
-                                 0.8f,
-                                 1.f);
+    // TRANSFER FUNCTION CREATION
+    // exact color of each label for the indexed lookup (empty if colors are a ramp over the label range)
+    std::vector<glm::vec3> label_colors;
+    // sets the opacity TF so that exactly the volume labels within the visible intervals are opaque
+    const auto setOpacityIntervals = [&](const std::vector<Interval>& visible, const bool indexed) {
+        opacityTF->RemoveAllPoints();
         // fill the opacity TF from the materials opacity vector
         // constexpr int TF_SIZE = (1 << 16) - 1;
         // if the transfer function texture size (= [min-max]/d where d is the minimal distance between neighboring points)
         // exceeds the OpenGL texture size limit (e.g. ), it must be rescaled. This creates false opacity lookups.
         const uint32_t TF_SIZE = label_max;
-        opacityTF->AddPoint(0., 0.0);
-        opacityTF->AddPoint(TF_SIZE, 0.0);
-        for (const auto& i : intervals) {
-            opacityTF->AddPoint(i.start, 0.);
-            opacityTF->AddPoint(i.start, VTK_FLOAT_MAX);
-            if (i.start == i.end && label_max < 32768u) {
-                // fix for single-label materials in data sets where the transfer function can actually sample all labels
-                opacityTF->AddPoint(i.end + 0.9, VTK_FLOAT_MAX);
-                opacityTF->AddPoint(i.end + 0.9, 0.);
-            } else {
-                // in data sets with more labels than transfer function entries, assign regions conservatively to retain empty space
-                opacityTF->AddPoint(i.end, VTK_FLOAT_MAX);
-                opacityTF->AddPoint(i.end, 0.);
+        if (indexed) {
+            // exact opacity of each label
+            std::vector<double> table(label_max + 1u);
+            for (uint32_t l = 0; l <= label_max; l++)
+                table[l] = intervalsContain(visible, l) ? VTK_FLOAT_MAX : 0.;
+            opacityTF->BuildFunctionFromTable(0., static_cast<double>(label_max), static_cast<int>(table.size()), table.data());
+        } else {
+            opacityTF->AddPoint(0., 0.0);
+            opacityTF->AddPoint(TF_SIZE, 0.0);
+            for (const auto& i : visible) {
+                opacityTF->AddPoint(i.start, 0.);
+                opacityTF->AddPoint(i.start, VTK_FLOAT_MAX);
+                if (i.start == i.end && label_max < 32768u) {
+                    // fix for single-label materials in data sets where the transfer function can actually sample all labels
+                    opacityTF->AddPoint(i.end + 0.9, VTK_FLOAT_MAX);
+                    opacityTF->AddPoint(i.end + 0.9, 0.);
+                } else {
+                    // in data sets with more labels than transfer function entries, assign regions conservatively to retain empty space
+                    opacityTF->AddPoint(i.end, VTK_FLOAT_MAX);
+                    opacityTF->AddPoint(i.end, 0.);
+                }
             }
         }
+    };
+    // one exact color and opacity table entry per label, also used when --serve requests select other materials
+    const bool exact = config.indexed_colors || config.material_colors || config.material_volume;
+    const bool indexed = exact && label_max < vvv::MAX_INDEXED_LABELS;
+    // exact opacity of each label baked from the materials (empty if derived from the label intervals)
+    std::vector<double> label_opacities;
+    {
+        if (exact && !indexed)
+            std::cout << "Too many labels for an indexed color lookup, use --remap-labels to compact them" << std::endl;
+
+        const auto original_label = [&](const uint32_t l) { return label_remap.empty() ? l : label_remap.original(l); };
+        if (config.material_volume) {
+            // material volumes are colored per material, index 0 is empty space
+            label_colors.assign(label_max + 1u, glm::vec3(0.f));
+            label_opacities.assign(label_max + 1u, 0.);
+            for (uint32_t m = 1; m <= label_max; m++) {
+                label_colors[m] = vvv::materialColor(params.materials[m - 1u], m - 1u);
+                label_opacities[m] = vvv::materialVisible(params.materials[m - 1u]) ? VTK_FLOAT_MAX : 0.;
+            }
+        } else if (indexed && config.material_colors) {
+            MiniTimer bake_timer;
+            const std::vector<glm::vec4> rgba = vvv::materialLabelColors(params.materials, label_materials, label_max + 1u,
+                                                                         original_label, config.thread_count);
+            label_colors.resize(rgba.size());
+            label_opacities.resize(rgba.size());
+            for (size_t l = 0; l < rgba.size(); l++) {
+                label_colors[l] = glm::vec3(rgba[l]);
+                // the first hit renderer only distinguishes transparent and opaque labels
+                label_opacities[l] = rgba[l].a > 0.f ? VTK_FLOAT_MAX : 0.;
+            }
+            if (config.verbose)
+                std::cout << "Baked material colors of " << rgba.size() << " labels in " << bake_timer.elapsed() << " s" << std::endl;
+        } else if (indexed) {
+            label_colors = vvv::hashedLabelColors(label_max + 1u, original_label, config.thread_count);
+        }
+
+        if (indexed) {
+            // one table entry per label: sampling the integer labels hits the table entries exactly
+            std::vector<double> table(3u * label_colors.size());
+            for (size_t l = 0; l < label_colors.size(); l++)
+                for (int c = 0; c < 3; c++)
+                    table[3u * l + c] = label_colors[l][c];
+            colorTF->BuildFunctionFromTable(0., static_cast<double>(label_max), static_cast<int>(label_colors.size()), table.data());
+        } else {
+            // Set up a single VTK color and opacity transfer function from the merged intervals
+            const int COLOR_TF_SIZE = glm::min(256u, label_max);
+            for (unsigned int x = 0; x < COLOR_TF_SIZE; x++)
+                colorTF->AddHSVPoint(static_cast<double>(x) * ((label_max + 1) / static_cast<double>(COLOR_TF_SIZE)),
+                                     static_cast<double>(pcg_hash(x) % 512u) / 512.,
+                                     0.8f,
+                                     1.f);
+        }
+        if (!label_opacities.empty()) {
+            opacityTF->BuildFunctionFromTable(0., static_cast<double>(label_max), static_cast<int>(label_opacities.size()),
+                                              label_opacities.data());
+        } else if (!label_remap.empty()) {
+            // remapped labels: all visible labels are in [0, visible_count) which is a single step with exact breakpoints
+            const double step = label_remap.visible_count - 0.5;
+            opacityTF->AddPoint(0., label_remap.visible_count > 0u ? VTK_FLOAT_MAX : 0.);
+            opacityTF->AddPoint(step, label_remap.visible_count > 0u ? VTK_FLOAT_MAX : 0.);
+            opacityTF->AddPoint(step, 0.);
+            opacityTF->AddPoint(glm::max(static_cast<double>(label_max), step), 0.);
+        } else {
+            setOpacityIntervals(intervals, indexed);
+        }
     }
+    // the fixed point ray caster looks up transfer functions in tables of at most 2^16 entries
+    if (config.renderer == CPU_FIXED_POINT && label_max > UINT16_MAX)
+        std::cout << "The fixed point renderer quantizes labels to 16 bit, use --remap-labels or --material-volume "
+                  << "for exact colors" << std::endl;
 
 
     // Set up the volume property
@@ -184,14 +737,67 @@ int main(int argc, char* argv[])
     volumeProperty->SetShade(true);
     volumeProperty->SetAmbient(0.3);
 
+    // CPU first-hit ray caster that replaces the VTK volume mapper if selected
+    std::optional<vvv::FirstHitRayCaster> cpuRayCaster;
+    // voxel index -> volume physical space -> world space (volume transform) -> clip space of the active VTK camera
+    const auto cpuVoxelToClip = [&](const double aspect) {
+        vtkImageData* image = volumeMapper->GetInput();
+        double origin[3], spacing[3];
+        image->GetOrigin(origin);
+        image->GetSpacing(spacing);
+        glm::mat4 voxel_to_clip;
+        vtkMatrix4x4* world_to_clip = renderer->GetActiveCamera()->GetCompositeProjectionTransformMatrix(aspect, -1., 1.);
+        const vtkSmartPointer<vtkMatrix4x4> voxel_to_world = vtkSmartPointer<vtkMatrix4x4>::New();
+        voxel_to_world->Identity();
+        for (int a = 0; a < 3; a++) {
+            voxel_to_world->SetElement(a, a, spacing[a]);
+            voxel_to_world->SetElement(a, 3, origin[a]);
+        }
+        vtkMatrix4x4::Multiply4x4(volume->GetMatrix(), voxel_to_world, voxel_to_world);
+        vtkMatrix4x4::Multiply4x4(world_to_clip, voxel_to_world, voxel_to_world);
+        for (int x = 0; x < 4; x++)
+            for (int y = 0; y < 4; y++)
+                voxel_to_clip[x][y] = static_cast<float>(voxel_to_world->GetElement(y, x));
+        return voxel_to_clip;
+    };
+
+    // scale of camera distances from Volcanite world space (largest volume axis has length 1) to VTK world space
+    double camera_scale = 1.;
+    // places the VTK camera at the view of a Volcanite camera, the projection is only set once from the .vcfg camera
+    const auto setVolcaniteView = [&](vvv::Camera camera) {
+        auto vtk_camera = renderer->GetActiveCamera();
+        const glm::vec3 position = camera.get_position();
+        const glm::vec3 up = camera.get_up_vector();
+        vtk_camera->SetPosition(position.x * camera_scale, position.y * camera_scale, position.z * camera_scale);
+        vtk_camera->SetViewUp(up.x, up.y, up.z);
+        vtk_camera->SetFocalPoint(camera.position_look_at_world_space.x * camera_scale,
+                                  camera.position_look_at_world_space.y * camera_scale,
+                                  camera.position_look_at_world_space.z * camera_scale);
+    };
+
+    // copies the projection of the .vcfg camera for the given aspect ratio
+    const auto setVolcaniteProjection = [&](const float aspect) {
+        auto vtk_camera = renderer->GetActiveCamera();
+        const vtkSmartPointer<vtkMatrix4x4> projMat = vtkSmartPointer<vtkMatrix4x4>::New();
+        const glm::mat4 proj = params.camera.get_view_to_projection_space(aspect);
+        for (int x = 0; x < 4; x++)
+            for (int y = 0; y < 4; y++)
+                projMat->SetElement(x, y, proj[y][x]);
+        projMat->SetElement(1, 1, projMat->GetElement(1, 1) * -1.);
+        vtk_camera->SetExplicitProjectionTransformMatrix(projMat);
+        vtk_camera->SetUseExplicitProjectionTransformMatrix(true);
+        vtk_camera->SetViewAngle(params.camera.vertical_fov / (2.f * M_PI) * 360.f);
+    };
+
     // CAMERA AND VOLUME TRANSFORMATIONS
     {
         auto& vcnt_camera = params.camera;
         auto vtk_camera = renderer->GetActiveCamera();
 
         // Calculate size of "raw" volume axes
+        // note: use the bounds of the complete volume to keep the transformations independent of the loaded region
         double raw_bounds[6];
-        volume->GetBounds(raw_bounds);
+        std::copy_n(volume_bounds, 6, raw_bounds);
         int maxDim = 0;
         for (int i = 0; i < 3; i++) {
             if ((raw_bounds[i*2 + 1] - raw_bounds[i*2]) > (raw_bounds[maxDim*2 + 1] - raw_bounds[maxDim*2]))
@@ -232,9 +838,21 @@ int main(int argc, char* argv[])
         clipped_bounds[3] = glm::min(raw_bounds[3], static_cast<double>(params.split_plane_y[1]) * params.axis_scale[1]);
         clipped_bounds[4] = glm::max(raw_bounds[4], static_cast<double>(params.split_plane_z[0]) * params.axis_scale[2]);
         clipped_bounds[5] = glm::min(raw_bounds[5], static_cast<double>(params.split_plane_z[1]) * params.axis_scale[2]);
+        // shrink to the visible voxels if the image was cropped tightly
+        for (int a = 0; a < 3; a++) {
+            clipped_bounds[2 * a] = glm::max(clipped_bounds[2 * a], visible_bounds[2 * a]);
+            clipped_bounds[2 * a + 1] = glm::min(clipped_bounds[2 * a + 1], visible_bounds[2 * a + 1]);
+        }
         volumeMapper->SetCropping(true);
         volumeMapper->SetCroppingRegionPlanes(clipped_bounds);
-        volumeMapper->SetSampleDistance(0.5);
+        // step size approx. half a voxel of the rendered pyramid level
+        const double sampleDistance = 0.5 * static_cast<double>(1 << lod_level);
+        if (auto* gpuMapper = vtkGPUVolumeRayCastMapper::SafeDownCast(volumeMapper))
+            gpuMapper->SetSampleDistance(static_cast<float>(sampleDistance));
+        else if (auto* fixedPointMapper = vtkFixedPointVolumeRayCastMapper::SafeDownCast(volumeMapper))
+            fixedPointMapper->SetSampleDistance(static_cast<float>(sampleDistance));
+        else if (auto* smartMapper = vtkSmartVolumeMapper::SafeDownCast(volumeMapper))
+            smartMapper->SetSampleDistance(static_cast<float>(sampleDistance));
 
         // Create camera transformations and projections
         {
@@ -245,26 +863,10 @@ int main(int argc, char* argv[])
             // Volcanite clipping assumes volume world space size of 1 in its clipping planes.
             // Move the far plane away before computing the projection matrix to not clip the volume back side in VTK.
             vcnt_camera.far = static_cast<float>(3.f * maxSize * vcnt_camera.far);
-            vtk_camera->SetPosition(vcnt_camera.get_position().x * maxSize,
-                                    vcnt_camera.get_position().y * maxSize,
-                                    vcnt_camera.get_position().z * maxSize);
-            const double cam_up[3] = {vcnt_camera.get_up_vector().x,
-                                      vcnt_camera.get_up_vector().y,
-                                      vcnt_camera.get_up_vector().z};
-            vtk_camera->SetViewUp(cam_up);
-            vtk_camera->SetFocalPoint(vcnt_camera.position_look_at_world_space.x * maxSize,
-                                      vcnt_camera.position_look_at_world_space.y * maxSize,
-                                      vcnt_camera.position_look_at_world_space.z * maxSize);
-
-            // Copy Volcanite camera projection matrix
-            const vtkSmartPointer<vtkMatrix4x4> projMat = vtkSmartPointer<vtkMatrix4x4>::New();
-            for (int x = 0; x < 4; x++)
-                for (int y = 0; y < 4; y++)
-                    projMat->SetElement(x, y, params.camera.get_view_to_projection_space(static_cast<float>(config.render_width)/static_cast<float>(config.render_height))[y][x]);
-            projMat->SetElement(1, 1, projMat->GetElement(1, 1) * -1.);
-            vtk_camera->SetExplicitProjectionTransformMatrix(projMat);
-            vtk_camera->SetUseExplicitProjectionTransformMatrix(true);
-            vtk_camera->SetViewAngle(vcnt_camera.vertical_fov / (2.f * M_PI) * 360.f);
+            camera_scale = maxSize;
+            setVolcaniteView(vcnt_camera);
+
+            setVolcaniteProjection(static_cast<float>(config.render_width) / static_cast<float>(config.render_height));
 
             // Load previously exported camera (if requested)
             if (!config.camera_import_file.empty()) {
@@ -273,6 +875,45 @@ int main(int argc, char* argv[])
             }
         }
 
+        // Set up the CPU ray caster with the same camera, volume transformation, cropping and shading as in VTK
+        if (config.renderer == CPU_FIRST_HIT)
+        {
+            vtkImageData* image = volumeMapper->GetInput();
+            double origin[3], spacing[3];
+            image->GetOrigin(origin);
+            image->GetSpacing(spacing);
+
+            // use the exact label colors or sample the color TF as VTK does for its color texture
+            std::vector<glm::vec3> colors = label_colors;
+            if (colors.empty()) {
+                // computed in 64 bit, label_max + 1 wraps to 0 for label_max = UINT32_MAX
+                const auto color_count = static_cast<int>(std::min<uint64_t>(uint64_t{label_max} + 1u, uint64_t{1} << 16));
+                colors.resize(color_count);
+                colorTF->GetTable(0., static_cast<double>(label_max), color_count, &colors[0].x);
+            }
+            // visible labels are opaque, all others are transparent
+            cpuRayCaster.emplace(image, visible_intervals, std::move(colors), label_max, config.thread_count);
+            cpuRayCaster->setDistanceLeaping(config.distance_leaping);
+
+            cpuRayCaster->setCamera(cpuVoxelToClip(static_cast<double>(config.render_width) / config.render_height));
+
+            glm::vec3 crop_min, crop_max;
+            for (int a = 0; a < 3; a++) {
+                crop_min[a] = static_cast<float>((clipped_bounds[2 * a] - origin[a]) / spacing[a]);
+                crop_max[a] = static_cast<float>((clipped_bounds[2 * a + 1] - origin[a]) / spacing[a]);
+            }
+            cpuRayCaster->setCropping(crop_min, crop_max);
+
+            vvv::FirstHitRayCaster::Shading shading;
+            shading.ambient = static_cast<float>(volumeProperty->GetAmbient());
+            shading.diffuse = static_cast<float>(volumeProperty->GetDiffuse());
+            shading.specular = static_cast<float>(volumeProperty->GetSpecular());
+            shading.specular_power = static_cast<float>(volumeProperty->GetSpecularPower());
+            const double* background = renderer->GetBackground();
+            shading.background = glm::vec3(background[0], background[1], background[2]);
+            cpuRayCaster->setShading(shading);
+        }
+
         // Display info (not when evaluating): create cube axes and transfer function overlay image
         if (!config.offscreen)
         {
@@ -295,63 +936,280 @@ int main(int argc, char* argv[])
 
     // RENDERING -------------------------------------------------------------------------------------------------------
 
+    if (cpuRayCaster && !config.offscreen && !config.serve_socket.has_value())
+    {
+        std::cerr << "The CPU renderer does not support interactive rendering" << std::endl;
+        return 1;
+    }
+
     // Create rendering window
     vtkSmartPointer<vtkRenderWindow> renderWindow = vtkSmartPointer<vtkRenderWindow>::New();
     renderWindow->AddRenderer(renderer);
     renderWindow->SetSize(config.render_width, config.render_height);
 
-    if (config.offscreen)
+    if (config.serve_socket.has_value())
+    {
+        // keep the volume, transfer functions and render context resident and render one image per request
+        if (!cpuRayCaster)
+        {
+            renderWindow->OffScreenRenderingOn();
+            renderWindow->MakeCurrent();
+        }
+        std::vector<uint8_t> cpuPixels;
+        vvv::RenderServer server(config.serve_socket.value(), stdout_buffer);
+        server.serve([&](const vvv::JsonRequest& request) {
+            const std::string dataName = getDataOutputName(config.data_set);
+            if (request.has("data_set") && request.string("data_set") != dataName)
+                throw std::runtime_error("this server renders " + dataName + ", start another server for other data sets");
+            if (request.has("materials"))
+            {
+                // indices of the .vcfg materials to render, the selection is kept for subsequent requests
+                std::vector<uint8_t> selection(params.materials.size(), 0u);
+                for (const double m : request.numberList("materials"))
+                {
+                    if (m < 0. || m >= static_cast<double>(selection.size()) || m != std::floor(m))
+                        throw std::runtime_error("invalid material index " + std::to_string(m));
+                    selection[static_cast<size_t>(m)] = 1u;
+                }
+                if (selection != material_selection)
+                {
+                    MiniTimer tf_timer;
+                    material_selection = selection;
+                    // visible labels in the label space of the image: material ids, dense labels or original labels
+                    std::vector<Interval> selected = selectedMaterialIntervals(material_selection);
+                    visible_intervals.clear();
+                    if (config.material_volume)
+                        visible_intervals = selectedMaterialIndices(material_selection);
+                    else if (!label_remap.empty())
+                    {
+                        // selected labels are a subset of the initially visible dense labels [0, visible_count)
+                        for (uint32_t d = 0; d < label_remap.visible_count; d++)
+                        {
+                            if (!intervalsContain(selected, label_remap.original(d)))
+                                continue;
+                            if (!visible_intervals.empty() && visible_intervals.back().end + 1u == d)
+                                visible_intervals.back().end = d;
+                            else
+                                visible_intervals.push_back({d, d});
+                        }
+                    }
+                    else
+                    {
+                        visible_intervals = selected;
+                    }
+                    if (cpuRayCaster)
+                        cpuRayCaster->setVisibleIntervals(visible_intervals);
+                    else if (!label_opacities.empty())
+                    {
+                        // keep the opacities baked from the materials and hide the labels of unselected materials
+                        std::vector<double> table(label_opacities.size());
+                        for (uint32_t l = 0; l < table.size(); l++)
+                            table[l] = intervalsContain(visible_intervals, l) ? label_opacities[l] : 0.;
+                        opacityTF->RemoveAllPoints();
+                        opacityTF->BuildFunctionFromTable(0., static_cast<double>(label_max), static_cast<int>(table.size()),
+                                                          table.data());
+                    }
+                    else
+                        setOpacityIntervals(visible_intervals, indexed);
+                    if (config.verbose)
+                        std::cout << "Updated visible materials in " << tf_timer.elapsed() << " s" << std::endl;
+                }
+            }
+            const int width = static_cast<int>(request.number("width", config.render_width));
+            const int height = static_cast<int>(request.number("height", config.render_height));
+            if (width <= 0 || height <= 0 || width > 16384 || height > 16384)
+                throw std::runtime_error("invalid resolution " + std::to_string(width) + "x" + std::to_string(height));
+
+            // the camera is either a VTK view as in camera exports or the orbital parameters of a Volcanite camera,
+            // the camera of the previous request is kept otherwise
+            vtkCamera* camera = renderer->GetActiveCamera();
+            if (request.has("position"))
+            {
+                CameraView view = getCameraView(camera);
+                const auto copy = [&](const std::string& key, double (&dst)[3]) {
+                    if (request.has(key))
+                        std::ranges::copy(request.numbers(key, 3), dst);
+                };
+                copy("position", view.position);
+                copy("focal_point", view.focal_point);
+                copy("view_up", view.view_up);
+                setCameraView(camera, view);
+            }
+            else if (request.has("rotation_x") || request.has("rotation_y") || request.has("orbital_radius") || request.has("look_at"))
+            {
+                vvv::Camera vcnt_camera = params.camera;
+                vcnt_camera.rotation_x = static_cast<float>(request.number("rotation_x", vcnt_camera.rotation_x));
+                vcnt_camera.rotation_y = static_cast<float>(request.number("rotation_y", vcnt_camera.rotation_y));
+                vcnt_camera.orbital_radius = static_cast<float>(request.number("orbital_radius", vcnt_camera.orbital_radius));
+                if (request.has("look_at"))
+                {
+                    const std::vector<double> look_at = request.numbers("look_at", 3);
+                    vcnt_camera.position_look_at_world_space = glm::vec3(look_at[0], look_at[1], look_at[2]);
+                }
+                setVolcaniteView(vcnt_camera);
+            }
+            const float aspect = static_cast<float>(width) / static_cast<float>(height);
+            setVolcaniteProjection(aspect);
+
+            double render_s;
+            if (cpuRayCaster)
+            {
+                cpuRayCaster->setCamera(cpuVoxelToClip(aspect));
+                MiniTimer render_timer;
+                cpuRayCaster->render(width, height, cpuPixels, config.thread_count);
+                render_s = render_timer.elapsed();
+            }
+            else
+            {
+                renderWindow->SetSize(width, height);
+                renderWindow->Render();
+                render_s = renderer->GetLastRenderTimeInSeconds();
+            }
+
+            MiniTimer export_timer;
+            const std::filesystem::path image_file = request.has("output") ? std::filesystem::path(request.string("output"))
+                                                     : config.image_export_dir / (dataName + ".png");
+            if (!(cpuRayCaster ? exportPixels(cpuPixels.data(), width, height, 4, image_file)
+                               : exportImage(renderWindow, image_file)))
+                throw std::runtime_error("could not write image " + image_file.string());
+            return R"({"status":"ok","file":)" + jsonString(image_file.string()) + R"(,"render_ms":)"
+                   + std::to_string(render_s * 1000.) + R"(,"export_ms":)" + std::to_string(export_timer.elapsed() * 1000.) + "}";
+        });
+    }
+    else if (config.offscreen)
     {
-        renderWindow->OffScreenRenderingOn();
-        renderWindow->MakeCurrent();
-
-        // render a single frame to trigger volume uploading to the GPU
-        // (interpreted as preprocessing = should not be measured in timings, but gives us the time to first frame)
-        renderWindow->Render();
-        renderer->GetLastRenderTimeInSeconds();
-        time_to_first_frame_s = timer.elapsed();
-        // Render and measure frame times (CPU side)
-        std::vector<double> cpuRenderTimes(config.render_frames, 0.);
-        for (int i = 0; i < config.render_frames; ++i)
+        // batch mode renders a list of views with the loaded volume, otherwise only the current view is rendered
+        std::vector<CameraView> views;
+        if (config.camera_list_file.has_value())
+            views = importCameraViews(config.camera_list_file.value());
+        else if (config.orbit_views > 0)
+            views = orbitCameraViews(renderer->GetActiveCamera(), config.orbit_views);
+        if (config.camera_list_file.has_value() && views.empty())
         {
-            renderWindow->Render();
-            cpuRenderTimes[i] = renderer->GetLastRenderTimeInSeconds();
+            std::cerr << "No camera views in " << config.camera_list_file.value() << std::endl;
+            return 1;
         }
+        const bool batch = !views.empty();
+        if (batch)
+            std::cout << "Rendering " << views.size() << " views" << std::endl;
 
-        EvalResult res = {};
-        for (int i = 0; i < config.render_frames; ++i)
+        if (cameraPath && !config.camera_import_file.empty())
+            std::cout << "Camera paths ignore the imported camera and start at the .vcfg camera" << std::endl;
+        const auto setPathFrame = [&](const int frame) {
+            if (!cameraPath)
+                return;
+            setVolcaniteView(pathCamera(frame));
+            if (cpuRayCaster)
+                cpuRayCaster->setCamera(cpuVoxelToClip(static_cast<double>(config.render_width) / config.render_height));
+        };
+
+        if (!cpuRayCaster)
         {
-            // convert to [ms]
-            cpuRenderTimes.at(i) *= 1000.;
-
-            // tracking variables
-            if (i < sizeof(EvalResult::frame) / sizeof(double))
-                res.frame[i] = cpuRenderTimes.at(i);
-            if (cpuRenderTimes.at(i) < res.min)
-                res.min = cpuRenderTimes.at(i);
-            if (cpuRenderTimes.at(i) > res.max)
-                res.max = cpuRenderTimes.at(i);
-            res.avg += cpuRenderTimes.at(i);
-            res.var += cpuRenderTimes.at(i) * cpuRenderTimes.at(i);
-        }
-        res.avg /= config.render_frames;
-        res.var = res.var/config.render_frames - (res.avg * res.avg);
+            renderWindow->OffScreenRenderingOn();
+            renderWindow->MakeCurrent();
+        }
+
+        for (size_t v = 0; v < std::max<size_t>(views.size(), 1u); v++)
         {
-            std::ranges::sort(cpuRenderTimes);
-            if (config.render_frames % 2 == 0)
-                res.med = (cpuRenderTimes[config.render_frames / 2] + cpuRenderTimes[config.render_frames / 2 + 1]) / 2.;
+            if (batch)
+            {
+                setCameraView(renderer->GetActiveCamera(), views[v]);
+                if (cpuRayCaster)
+                    cpuRayCaster->setCamera(cpuVoxelToClip(static_cast<double>(config.render_width) / config.render_height));
+            }
+
+            // the first frame of the first view includes the volume import and upload,
+            // later views only measure their first frame with warm caches
+            MiniTimer first_frame_timer;
+            std::vector<double> cpuRenderTimes(config.render_frames, 0.);
+            std::vector<uint8_t> cpuPixels;
+            setPathFrame(0);
+            if (cpuRayCaster)
+            {
+                cpuRayCaster->render(config.render_width, config.render_height, cpuPixels, config.thread_count);
+                time_to_first_frame_s = v == 0 ? timer.elapsed() : first_frame_timer.elapsed();
+                for (int i = 0; i < config.render_frames; ++i)
+                {
+                    setPathFrame(i);
+                    MiniTimer frame_timer;
+                    cpuRayCaster->render(config.render_width, config.render_height, cpuPixels, config.thread_count);
+                    cpuRenderTimes[i] = frame_timer.elapsed();
+                }
+            }
             else
-                res.med = cpuRenderTimes[config.render_frames / 2];
-        }
-        res.time_io_s = timer_io_s;
-        res.time_to_first_frame = time_to_first_frame_s;
+            {
+                // render a single frame to trigger volume uploading to the GPU
+                // (interpreted as preprocessing = should not be measured in timings, but gives us the time to first frame)
+                renderWindow->Render();
+                renderer->GetLastRenderTimeInSeconds();
+                time_to_first_frame_s = v == 0 ? timer.elapsed() : first_frame_timer.elapsed();
+                // Render and measure frame times (CPU side)
+                for (int i = 0; i < config.render_frames; ++i)
+                {
+                    setPathFrame(i);
+                    renderWindow->Render();
+                    cpuRenderTimes[i] = renderer->GetLastRenderTimeInSeconds();
+                }
+            }
 
-        std::cout << "Rendered " << config.render_frames << " frames. Average render time: " << res.avg << " ms/frame." << std::endl;
+            EvalResult res = {};
+            for (int i = 0; i < config.render_frames; ++i)
+            {
+                // convert to [ms]
+                cpuRenderTimes.at(i) *= 1000.;
 
-        // export results
-        exportResults(getDataOutputName(config.data_set), res, config.csv_result_file, config.verbose);
-        exportImage(renderWindow, config.image_export_override_file.has_value() ? config.image_export_override_file.value()
-                                    : config.image_export_dir / (getDataOutputName(config.data_set) + ".png"));
+                // tracking variables
+                if (i < sizeof(EvalResult::frame) / sizeof(double))
+                    res.frame[i] = cpuRenderTimes.at(i);
+                if (cpuRenderTimes.at(i) < res.min)
+                    res.min = cpuRenderTimes.at(i);
+                if (cpuRenderTimes.at(i) > res.max)
+                    res.max = cpuRenderTimes.at(i);
+                res.avg += cpuRenderTimes.at(i);
+                res.var += cpuRenderTimes.at(i) * cpuRenderTimes.at(i);
+            }
+            res.avg /= config.render_frames;
+            res.var = res.var/config.render_frames - (res.avg * res.avg);
+            // frame times in render order
+            const std::vector<double> frameTimes = cpuRenderTimes;
+            {
+                std::ranges::sort(cpuRenderTimes);
+                if (config.render_frames % 2 == 0)
+                    res.med = (cpuRenderTimes[config.render_frames / 2] + cpuRenderTimes[config.render_frames / 2 + 1]) / 2.;
+                else
+                    res.med = cpuRenderTimes[config.render_frames / 2];
+            }
+            res.time_io_s = timer_io_s;
+            res.time_to_first_frame = time_to_first_frame_s;
+            res.io_threads = read_info.threads;
+            res.io_gb_per_s = read_info.gb_per_s();
+            res.io_cached = static_cast<bool>(cached_volume) || static_cast<bool>(shared_volume);
+            res.renderer = getRendererName(config.renderer);
+
+            std::string name = getDataOutputName(config.data_set) + (batch ? "_view" + std::to_string(v) : "");
+            if (cameraPath)
+                name += "_" + vvv::CameraPath::name(cameraPath->type());
+            std::cout << "Rendered " << config.render_frames << " frames" << (batch ? " of view " + std::to_string(v) : "")
+                      << ". Average render time: " << res.avg << " ms/frame." << std::endl;
+
+            // export results
+            exportResults(name, res, config.csv_result_file, config.verbose);
+            if (cameraPath)
+            {
+                // view dependent costs are only visible in the individual frame times
+                std::filesystem::path frames_file = config.csv_result_file;
+                frames_file.replace_filename(frames_file.stem().string() + "_frames" + frames_file.extension().string());
+                exportFrameTimes(name, frameTimes, frames_file);
+            }
+            std::filesystem::path image_file = config.image_export_override_file.has_value() ? config.image_export_override_file.value()
+                                               : config.image_export_dir / (getDataOutputName(config.data_set) + ".png");
+            if (batch)
+                image_file.replace_filename(image_file.stem().string() + "_view" + std::to_string(v) + image_file.extension().string());
+            if (cpuRayCaster)
+                exportPixels(cpuPixels.data(), config.render_width, config.render_height, 4, image_file);
+            else
+                exportImage(renderWindow, image_file);
+        }
     }
     else
     {
@@ -376,3 +1234,17 @@ int main(int argc, char* argv[])
     }
     return 0;
 }
+
+int main(int argc, char* argv[])
+{
+    // invalid arguments, files or volumes are reported like missing input files instead of terminating
+    try
+    {
+        return run(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vvv {
+
+/// @return the number of worker threads to use if thread_count is 0 (= all hardware threads), thread_count otherwise
+inline unsigned resolve_thread_count(const unsigned thread_count = 0u) {
+    if (thread_count > 0u)
+        return thread_count;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/// Executes func(i, thread_idx) for all work items i in [0, count) on thread_count worker threads.
+/// Work items are fetched dynamically from a shared counter so that items of varying cost are balanced.
+/// The calling thread participates as worker 0. The first exception thrown by any worker is rethrown.
+/// @param count number of work items
+/// @param thread_count number of worker threads, 0 for all hardware threads
+/// @param func callable with signature void(size_t item, unsigned thread_idx)
+template <typename F>
+void parallel_for(const size_t count, const unsigned thread_count, F &&func) {
+    const unsigned threads = static_cast<unsigned>(std::min<size_t>(resolve_thread_count(thread_count), std::max<size_t>(count, 1)));
+
+    std::atomic<size_t> next_item = 0;
+    std::exception_ptr error = nullptr;
+    std::mutex error_mutex;
+    auto worker = [&](const unsigned thread_idx) {
+        try {
+            for (size_t i = next_item++; i < count; i = next_item++)
+                func(i, thread_idx);
+        } catch (...) {
+            std::scoped_lock lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            // stop all other workers early
+            next_item = count;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(worker, t);
+    worker(0);
+    for (auto &t : pool)
+        t.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/// Splits [0, count) into contiguous ranges of at most block_size items and executes func(begin, end, thread_idx)
+/// for each range on thread_count worker threads.
+template <typename F>
+void parallel_for_blocks(const size_t count, const size_t block_size, const unsigned thread_count, F &&func) {
+    const size_t blocks = (count + block_size - 1) / block_size;
+    parallel_for(blocks, thread_count, [&](const size_t b, const unsigned thread_idx) {
+        func(b * block_size, std::min(count, (b + 1) * block_size), thread_idx);
+    });
+}
+
+} // namespace vvv
@@ -15,13 +15,28 @@
 
 #pragma once
 
+#include <atomic>
 #include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #ifdef LIB_HIGHFIVE
     #include <highfive/H5File.hpp>
 #endif
+#ifdef LIB_ZLIB
+    #include <zlib.h>
+#endif
+
+#include "parallel.hpp"
+#include "MiniTimer.hpp"
+#include "VoxelRegion.hpp"
 
 namespace vvv {
 
@@ -60,4 +75,442 @@ void read_hdf5(const std::string& url, size_t (&dim_xyz)[3], T* output_data = nu
 }
 
 
+#ifdef LIB_HIGHFIVE
+/// @return the size in bytes of the integer type in which the labels of the hdf5 data set are stored
+inline size_t read_hdf5_label_bytes(const HighFive::DataSet& dataset) {
+    const hid_t file_type = H5Dget_type(dataset.getId());
+    const bool is_integer = H5Tget_class(file_type) == H5T_INTEGER;
+    const size_t bytes = H5Tget_size(file_type);
+    H5Tclose(file_type);
+    if (!is_integer)
+        throw std::runtime_error("hdf5 volume file data set must store integer labels.");
+    return bytes;
+}
+#endif
+
+/// @return the size in bytes of the integer type in which the labels of the hdf5 volume are stored
+inline size_t read_hdf5_label_bytes(const std::string& url) {
+#ifdef LIB_HIGHFIVE
+    HighFive::File file(url, HighFive::File::ReadOnly);
+    return read_hdf5_label_bytes(file.getDataSet(file.getObjectName(0)));
+#else
+    throw std::runtime_error("HighFIVE / HDF5 libraries not found! Cannot load .hdf5 volume file!");
+#endif
+}
+
+/// Statistics of a (parallel) hdf5 volume import.
+struct Hdf5ReadInfo {
+    size_t bytes = 0;           ///< decompressed bytes written to the output buffer
+    size_t chunks = 0;          ///< number of chunks (or slabs for non-chunked data sets) that were read
+    unsigned threads = 1;       ///< number of threads used for reading and decompressing
+    bool parallel = false;      ///< if chunks were decompressed in parallel or the serial hyperslab fallback was used
+    double seconds = 0.;        ///< wall clock time of the import
+
+    [[nodiscard]] double gb_per_s() const { return seconds > 0. ? static_cast<double>(bytes) / seconds * 1.e-9 : 0.; }
+};
+
+namespace detail {
+
+/// Default row visitor of read_hdf5_chunked that ignores all rows.
+struct NoRowVisitor {
+    template <typename T>
+    void operator()(unsigned, const T*, size_t) const {}
+};
+
+#ifdef LIB_HIGHFIVE
+/// Owns an HDF5 identifier and closes it when leaving the scope, also if an exception is thrown.
+class Hdf5Handle {
+  public:
+    Hdf5Handle(const hid_t id, herr_t (*close)(hid_t)) : m_id(id), m_close(close) {}
+    ~Hdf5Handle() {
+        if (m_id >= 0)
+            m_close(m_id);
+    }
+    Hdf5Handle(const Hdf5Handle &) = delete;
+    Hdf5Handle &operator=(const Hdf5Handle &) = delete;
+
+    operator hid_t() const { return m_id; }
+
+  private:
+    hid_t m_id;
+    herr_t (*m_close)(hid_t);
+};
+
+/// Reverts the HDF5 shuffle filter which stores the i-th byte of all elements consecutively.
+inline void hdf5_unshuffle(const uint8_t* in, uint8_t* out, const size_t bytes, const size_t element_size) {
+    const size_t n = bytes / element_size;
+    for (size_t b = 0; b < element_size; b++)
+        for (size_t i = 0; i < n; i++)
+            out[i * element_size + b] = in[b * n + i];
+    // trailing bytes that do not form a full element are not shuffled
+    std::memcpy(out + n * element_size, in + n * element_size, bytes - n * element_size);
+}
+
+/// @return the HDF5 native memory type matching T
+template <typename T>
+hid_t hdf5_native_type() {
+    if constexpr (std::is_same_v<T, uint8_t>) return H5T_NATIVE_UINT8;
+    else if constexpr (std::is_same_v<T, uint16_t>) return H5T_NATIVE_UINT16;
+    else if constexpr (std::is_same_v<T, uint32_t>) return H5T_NATIVE_UINT32;
+    else if constexpr (std::is_same_v<T, uint64_t>) return H5T_NATIVE_UINT64;
+    else if constexpr (std::is_same_v<T, int8_t>) return H5T_NATIVE_INT8;
+    else if constexpr (std::is_same_v<T, int16_t>) return H5T_NATIVE_INT16;
+    else if constexpr (std::is_same_v<T, int32_t>) return H5T_NATIVE_INT32;
+    else if constexpr (std::is_same_v<T, int64_t>) return H5T_NATIVE_INT64;
+    else static_assert(sizeof(T) == 0, "unsupported hdf5 volume type");
+}
+
+/// Calls func.template operator()<S>() with S being the unsigned integer type of the given byte size.
+template <typename F>
+void visit_unsigned_type(const size_t bytes, F&& func) {
+    switch (bytes) {
+    case 1: func.template operator()<uint8_t>(); break;
+    case 2: func.template operator()<uint16_t>(); break;
+    case 4: func.template operator()<uint32_t>(); break;
+    case 8: func.template operator()<uint64_t>(); break;
+    default: throw std::runtime_error("unsupported hdf5 integer size " + std::to_string(bytes));
+    }
+}
+
+/// Calls func.template operator()<S>() with S being the signed or unsigned integer type of the given byte size.
+template <typename F>
+void visit_integer_type(const size_t bytes, const bool is_signed, F&& func) {
+    if (!is_signed) {
+        visit_unsigned_type(bytes, std::forward<F>(func));
+        return;
+    }
+    switch (bytes) {
+    case 1: func.template operator()<int8_t>(); break;
+    case 2: func.template operator()<int16_t>(); break;
+    case 4: func.template operator()<int32_t>(); break;
+    case 8: func.template operator()<int64_t>(); break;
+    default: throw std::runtime_error("unsupported hdf5 integer size " + std::to_string(bytes));
+    }
+}
+
+/// Copies count elements from src to dst, converting from the stored type S to the output type T.
+/// @return false if a value of src does not fit into T
+template <typename S, typename T>
+bool convert_row(const S* src, T* dst, const size_t count) {
+    if constexpr (std::is_same_v<S, T>) {
+        std::memcpy(dst, src, count * sizeof(T));
+        return true;
+    } else {
+        S min = std::numeric_limits<S>::max(), max = std::numeric_limits<S>::lowest();
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = static_cast<T>(src[i]);
+            min = std::min(min, src[i]);
+            max = std::max(max, src[i]);
+        }
+        return count == 0u || (std::cmp_greater_equal(min, std::numeric_limits<T>::min())
+                               && std::cmp_less_equal(max, std::numeric_limits<T>::max()));
+    }
+}
+
+/// HDF5 filters for which chunks are decoded by our own parallel pipeline instead of the library.
+inline bool hdf5_filter_supported(const H5Z_filter_t filter) {
+#ifdef LIB_ZLIB
+    if (filter == H5Z_FILTER_DEFLATE)
+        return true;
+#endif
+    return filter == H5Z_FILTER_SHUFFLE;
+}
+#endif
+
+} // namespace detail
+
+/// Reads the given region of a 3D hdf5 volume into the pre-allocated output_data of size region.voxels().
+/// dim_xyz is set to the dimensions of the full volume. The region is clamped to the volume dimensions before reading.
+/// For chunked unsigned integer data sets that only use the shuffle and deflate filters, raw chunks intersecting the region
+/// are fetched from the file and decompressed concurrently by thread_count threads, converting each chunk from its stored
+/// type to T while writing it directly to its location in output_data. Wider stored types (e.g. 64 bit labels) are
+/// narrowed chunk by chunk without a full size staging buffer. An exception is thrown if a label does not fit into T.
+/// Access to the HDF5 library itself is serialized as it is not guaranteed to be thread safe.
+/// All other data sets are read slab by slab through the HDF5 filter pipeline on a single thread. As HDF5 clamps values
+/// that do not fit into the memory type, integers of another type are read in their stored type and converted with the
+/// same check, staging at most one chunk slab (or 256 MB of contiguous data) at a time.
+/// Each contiguous row of output voxels is passed to on_rows(thread_idx, row_data, row_length) directly after it was
+/// written, which allows computing per-voxel statistics while the data is still in cache. thread_idx is smaller than
+/// resolve_thread_count(thread_count) and rows passed with the same thread_idx are never visited concurrently.
+/// @param thread_count number of decompression threads, 0 for all hardware threads
+/// @param region voxel region [min, max) to read, the full volume by default
+/// @param on_rows visitor called for each row of voxels written to output_data
+/// @return statistics of the import, including the achieved throughput
+#ifdef LIB_HIGHFIVE
+template <typename T, typename RowVisitor = detail::NoRowVisitor>
+Hdf5ReadInfo read_hdf5_chunked(const HighFive::DataSet& dataset, size_t (&dim_xyz)[3], T* output_data,
+                               const unsigned thread_count = 0u, const VoxelRegion& region = {},
+                               RowVisitor&& on_rows = RowVisitor{}) {
+    MiniTimer timer;
+    Hdf5ReadInfo info;
+
+    const hid_t dset = dataset.getId();
+
+    std::vector<size_t> dimensions = dataset.getDimensions();
+    if (dimensions.size() != 3) {
+        throw std::runtime_error("hdf5 volume file data set must have exactly 3 dimensions.");
+    }
+    dim_xyz[0] = dimensions[2];
+    dim_xyz[1] = dimensions[1];
+    dim_xyz[2] = dimensions[0];
+    const VoxelRegion roi = region.clamped(dim_xyz);
+    info.bytes = roi.voxels() * sizeof(T);
+    if (roi.empty()) {
+        info.seconds = timer.elapsed();
+        return info;
+    }
+    // the hdf5 data set stores the volume in zyx order
+    const size_t roi_min_zyx[3] = {roi.min[2], roi.min[1], roi.min[0]};
+    const size_t roi_max_zyx[3] = {roi.max[2], roi.max[1], roi.max[0]};
+    const size_t roi_extent_zyx[3] = {roi.extent(2), roi.extent(1), roi.extent(0)};
+
+    // check if the chunks can be decoded by us: chunked layout, supported filters, native unsigned integer type
+    const detail::Hdf5Handle dcpl(H5Dget_create_plist(dset), H5Pclose);
+    const detail::Hdf5Handle file_type(H5Dget_type(dset), H5Tclose);
+    const hid_t mem_type = detail::hdf5_native_type<T>();
+    const bool chunked = H5Pget_layout(dcpl) == H5D_CHUNKED;
+    const size_t stored_bytes_per_voxel = H5Tget_size(file_type);
+    bool decode_chunks = chunked && H5Tget_class(file_type) == H5T_INTEGER && H5Tget_sign(file_type) == H5T_SGN_NONE
+                         && H5Tget_order(file_type) == H5Tget_order(mem_type)
+                         && (stored_bytes_per_voxel == 1 || stored_bytes_per_voxel == 2
+                             || stored_bytes_per_voxel == 4 || stored_bytes_per_voxel == 8);
+    hsize_t chunk_zyx[3] = {dimensions[0], dimensions[1], dimensions[2]};
+    if (chunked)
+        H5Pget_chunk(dcpl, 3, chunk_zyx);
+    std::vector<H5Z_filter_t> filters;
+    if (decode_chunks) {
+        const int filter_count = H5Pget_nfilters(dcpl);
+        for (int f = 0; f < filter_count; f++) {
+            unsigned flags;
+            size_t cd_nelmts = 0;
+            unsigned filter_config;
+            filters.push_back(H5Pget_filter2(dcpl, f, &flags, &cd_nelmts, nullptr, 0, nullptr, &filter_config));
+            decode_chunks &= detail::hdf5_filter_supported(filters.back());
+        }
+    }
+
+    // range of chunks [chunk_first, chunk_first + chunk_count) that intersect the region
+    size_t chunk_first[3], chunk_count[3];
+    for (int a = 0; a < 3; a++) {
+        chunk_first[a] = roi_min_zyx[a] / chunk_zyx[a];
+        chunk_count[a] = (roi_max_zyx[a] + chunk_zyx[a] - 1) / chunk_zyx[a] - chunk_first[a];
+    }
+    info.chunks = chunk_count[0] * chunk_count[1] * chunk_count[2];
+
+    if (decode_chunks) {
+        info.parallel = true;
+        info.threads = static_cast<unsigned>(std::min<size_t>(resolve_thread_count(thread_count), info.chunks));
+
+        H5D_space_status_t space_status;
+        H5Dget_space_status(dset, &space_status);
+        const bool any_allocated = space_status != H5D_SPACE_STATUS_NOT_ALLOCATED;
+
+        const size_t chunk_elements = chunk_zyx[0] * chunk_zyx[1] * chunk_zyx[2];
+        std::vector<std::vector<uint8_t>> compressed(info.threads), decoded(info.threads), tmp(info.threads);
+        std::mutex hdf5_mutex;
+        std::atomic<bool> overflow = false;
+
+        // chunks are decoded in their stored type S and converted to T while copying them to the output buffer
+        detail::visit_unsigned_type(stored_bytes_per_voxel, [&]<typename S>() {
+            S fill_value = 0;
+            H5Pget_fill_value(dcpl, detail::hdf5_native_type<S>(), &fill_value);
+
+            parallel_for(info.chunks, info.threads, [&](const size_t c, const unsigned t) {
+                const hsize_t offset_zyx[3] = {(chunk_first[0] + c / (chunk_count[2] * chunk_count[1])) * chunk_zyx[0],
+                                               (chunk_first[1] + (c / chunk_count[2]) % chunk_count[1]) * chunk_zyx[1],
+                                               (chunk_first[2] + c % chunk_count[2]) * chunk_zyx[2]};
+                decoded[t].resize(chunk_elements * sizeof(S));
+
+                // fetch the raw (compressed) chunk bytes from the file
+                uint32_t filter_mask = 0u;
+                bool allocated = false;
+                if (any_allocated) {
+                    std::scoped_lock lock(hdf5_mutex);
+                    haddr_t address;
+                    hsize_t stored_bytes = 0;
+                    if (H5Dget_chunk_info_by_coord(dset, offset_zyx, &filter_mask, &address, &stored_bytes) < 0)
+                        throw std::runtime_error("could not query hdf5 chunk info");
+                    allocated = address != HADDR_UNDEF && stored_bytes > 0;
+                    if (allocated) {
+                        compressed[t].resize(stored_bytes);
+                        if (H5Dread_chunk(dset, H5P_DEFAULT, offset_zyx, &filter_mask, compressed[t].data()) < 0)
+                            throw std::runtime_error("could not read hdf5 chunk");
+                    }
+                }
+
+                if (!allocated) {
+                    std::fill_n(reinterpret_cast<S*>(decoded[t].data()), chunk_elements, fill_value);
+                } else {
+                    // revert the filter pipeline in reverse order, skipping filters that were disabled for this chunk
+                    std::vector<uint8_t>* src = &compressed[t];
+                    for (int f = static_cast<int>(filters.size()) - 1; f >= 0; f--) {
+                        if (filter_mask & (1u << f))
+                            continue;
+                        std::vector<uint8_t>* dst = (src == &tmp[t]) ? &decoded[t] : &tmp[t];
+                        dst->resize(chunk_elements * sizeof(S));
+                        if (filters[f] == H5Z_FILTER_SHUFFLE) {
+                            detail::hdf5_unshuffle(src->data(), dst->data(), dst->size(), sizeof(S));
+                        }
+#ifdef LIB_ZLIB
+                        else if (filters[f] == H5Z_FILTER_DEFLATE) {
+                            uLongf dst_bytes = dst->size();
+                            if (uncompress(dst->data(), &dst_bytes, src->data(), src->size()) != Z_OK)
+                                throw std::runtime_error("could not inflate hdf5 chunk");
+                            // a short chunk would leave stale bytes of the previous chunk of this thread
+                            if (dst_bytes != dst->size())
+                                throw std::runtime_error("hdf5 chunk inflates to " + std::to_string(dst_bytes) + " instead of "
+                                                         + std::to_string(dst->size()) + " bytes");
+                        }
+#endif
+                        src = dst;
+                    }
+                    if (src != &decoded[t])
+                        std::memcpy(decoded[t].data(), src->data(), chunk_elements * sizeof(S));
+                }
+
+                // copy all rows of the chunk that lie within the region to the output buffer
+                size_t lo[3], hi[3];
+                for (int a = 0; a < 3; a++) {
+                    lo[a] = std::max<size_t>(offset_zyx[a], roi_min_zyx[a]);
+                    hi[a] = std::min<size_t>(offset_zyx[a] + chunk_zyx[a], roi_max_zyx[a]);
+                }
+                const S* chunk_data = reinterpret_cast<const S*>(decoded[t].data());
+                bool fits = true;
+                for (size_t z = lo[0]; z < hi[0]; z++) {
+                    for (size_t y = lo[1]; y < hi[1]; y++) {
+                        T* row = output_data + ((z - roi_min_zyx[0]) * roi_extent_zyx[1] + y - roi_min_zyx[1]) * roi_extent_zyx[2]
+                                 + lo[2] - roi_min_zyx[2];
+                        fits &= detail::convert_row(chunk_data + ((z - offset_zyx[0]) * chunk_zyx[1] + y - offset_zyx[1]) * chunk_zyx[2]
+                                                               + lo[2] - offset_zyx[2],
+                                                    row, hi[2] - lo[2]);
+                        on_rows(t, static_cast<const T*>(row), hi[2] - lo[2]);
+                    }
+                }
+                if (!fits)
+                    overflow = true;
+            });
+        });
+        if (overflow)
+            throw std::runtime_error("hdf5 volume contains labels that exceed the output label type");
+    } else {
+        // fallback: let HDF5 read z slabs of the region (aligned to the chunk size if the data set is chunked)
+        const bool is_integer = H5Tget_class(file_type) == H5T_INTEGER;
+        const bool is_signed = H5Tget_sign(file_type) == H5T_SGN_2;
+        const bool convert = is_integer && (stored_bytes_per_voxel != sizeof(T) || is_signed != std::is_signed_v<T>);
+        hsize_t slab_depth = chunk_zyx[0];
+        if (convert && !chunked) {
+            constexpr size_t STAGING_BYTES = size_t{1} << 28;
+            slab_depth = std::max<hsize_t>(1u, STAGING_BYTES / (roi_extent_zyx[1] * roi_extent_zyx[2] * stored_bytes_per_voxel));
+        }
+        info.chunks = 0u;
+        std::atomic<bool> overflow = false;
+        const detail::Hdf5Handle file_space(H5Dget_space(dset), H5Sclose);
+        for (hsize_t z = roi_min_zyx[0]; z < roi_max_zyx[0]; z = (z / slab_depth + 1u) * slab_depth) {
+            info.chunks++;
+            const hsize_t offset_zyx[3] = {z, roi_min_zyx[1], roi_min_zyx[2]};
+            const hsize_t count_zyx[3] = {std::min<hsize_t>((z / slab_depth + 1u) * slab_depth, roi_max_zyx[0]) - z,
+                                          roi_extent_zyx[1], roi_extent_zyx[2]};
+            const size_t rows = count_zyx[0] * count_zyx[1];
+            const detail::Hdf5Handle mem_space(H5Screate_simple(3, count_zyx, nullptr), H5Sclose);
+            H5Sselect_hyperslab(file_space, H5S_SELECT_SET, offset_zyx, nullptr, count_zyx, nullptr);
+            T* slab = output_data + (offset_zyx[0] - roi_min_zyx[0]) * roi_extent_zyx[1] * roi_extent_zyx[2];
+            herr_t status;
+            if (convert) {
+                detail::visit_integer_type(stored_bytes_per_voxel, is_signed, [&]<typename S>() {
+                    std::vector<S> stored(rows * count_zyx[2]);
+                    status = H5Dread(dset, detail::hdf5_native_type<S>(), mem_space, file_space, H5P_DEFAULT, stored.data());
+                    if (status < 0)
+                        return;
+                    parallel_for_blocks(rows, 256u, thread_count, [&](const size_t begin, const size_t end, const unsigned t) {
+                        bool fits = true;
+                        for (size_t row = begin; row < end; row++) {
+                            fits &= detail::convert_row(stored.data() + row * count_zyx[2], slab + row * count_zyx[2], count_zyx[2]);
+                            on_rows(t, static_cast<const T*>(slab + row * count_zyx[2]), count_zyx[2]);
+                        }
+                        if (!fits)
+                            overflow = true;
+                    });
+                });
+            } else {
+                status = H5Dread(dset, mem_type, mem_space, file_space, H5P_DEFAULT, slab);
+                // visit the slab in parallel while it is still (partially) cached
+                if (status >= 0) {
+                    parallel_for_blocks(rows, 256u, thread_count, [&](const size_t begin, const size_t end, const unsigned t) {
+                        for (size_t row = begin; row < end; row++)
+                            on_rows(t, static_cast<const T*>(slab + row * count_zyx[2]), count_zyx[2]);
+                    });
+                }
+            }
+            if (status < 0)
+                throw std::runtime_error("could not read hdf5 volume slab");
+            if (overflow)
+                throw std::runtime_error("hdf5 volume contains labels that exceed the output label type");
+        }
+    }
+
+    info.seconds = timer.elapsed();
+    return info;
+}
+#endif
+
+/// Opens the first data set of the hdf5 file and reads the region as above.
+template <typename T, typename RowVisitor = detail::NoRowVisitor>
+Hdf5ReadInfo read_hdf5_chunked(const std::string& url, size_t (&dim_xyz)[3], T* output_data, const unsigned thread_count = 0u,
+                               const VoxelRegion& region = {}, RowVisitor&& on_rows = RowVisitor{}) {
+#ifdef LIB_HIGHFIVE
+    MiniTimer timer;
+    HighFive::File file(url, HighFive::File::ReadOnly);
+    Hdf5ReadInfo info = read_hdf5_chunked<T>(file.getDataSet(file.getObjectName(0)), dim_xyz, output_data, thread_count,
+                                             region, std::forward<RowVisitor>(on_rows));
+    info.seconds = timer.elapsed();
+    return info;
+#else
+    throw std::runtime_error("HighFIVE / HDF5 libraries not found! Cannot load .hdf5 volume file!");
+#endif
+}
+
+/// Keeps the first data set of an hdf5 file open, which provides its dimensions and label size for allocating the
+/// output before reading it with read_hdf5_chunked without opening the file again.
+class Hdf5Volume {
+  public:
+    explicit Hdf5Volume(const std::string& url) {
+#ifdef LIB_HIGHFIVE
+        m_file = std::make_unique<HighFive::File>(url, HighFive::File::ReadOnly);
+        m_dataset = std::make_unique<HighFive::DataSet>(m_file->getDataSet(m_file->getObjectName(0)));
+        const std::vector<size_t> dimensions = m_dataset->getDimensions();
+        if (dimensions.size() != 3)
+            throw std::runtime_error("hdf5 volume file data set must have exactly 3 dimensions.");
+        for (int a = 0; a < 3; a++)
+            m_dim[a] = dimensions[2 - a];
+        m_label_bytes = read_hdf5_label_bytes(*m_dataset);
+#else
+        throw std::runtime_error("HighFIVE / HDF5 libraries not found! Cannot load .hdf5 volume file!");
+#endif
+    }
+
+    [[nodiscard]] const size_t (&dimensions() const)[3] { return m_dim; }
+    /// @return the size in bytes of the integer type in which the labels are stored
+    [[nodiscard]] size_t labelBytes() const { return m_label_bytes; }
+
+    /// Reads the region of the volume as read_hdf5_chunked.
+    template <typename T, typename RowVisitor = detail::NoRowVisitor>
+    Hdf5ReadInfo read(T* output_data, const unsigned thread_count = 0u, const VoxelRegion& region = {},
+                      RowVisitor&& on_rows = RowVisitor{}) const {
+#ifdef LIB_HIGHFIVE
+        size_t dim[3];
+        return read_hdf5_chunked<T>(*m_dataset, dim, output_data, thread_count, region, std::forward<RowVisitor>(on_rows));
+#else
+        throw std::runtime_error("HighFIVE / HDF5 libraries not found! Cannot load .hdf5 volume file!");
+#endif
+    }
+
+  private:
+#ifdef LIB_HIGHFIVE
+    std::unique_ptr<HighFive::File> m_file;
+    std::unique_ptr<HighFive::DataSet> m_dataset;
+#endif
+    size_t m_dim[3] = {0u, 0u, 0u};
+    size_t m_label_bytes = 0u;
+};
+
 } // namespace vvv
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "MappedFile.hpp"
+#include "parallel.hpp"
+#include "util.hpp"
+
+namespace vvv {
+
+/// Parsed NRRD header of a raw encoded 3D label volume.
+/// See https://teem.sourceforge.net/nrrd/format.html for the format specification.
+struct NrrdHeader {
+    std::filesystem::path data_file;        ///< file containing the raw voxel data
+    size_t byte_skip = 0u;                  ///< offset of the voxel data in the data file
+    bool byte_skip_from_end = false;        ///< byte skip: -1, the voxel data is stored at the end of the data file
+    size_t label_bytes = 0u;                ///< bytes per voxel label, labels are unsigned integers
+    bool big_endian = false;
+    size_t sizes[3] = {0u, 0u, 0u};         ///< number of samples along each file axis, fastest axis first
+    double spacings[3] = {NAN, NAN, NAN};   ///< sample spacing along each file axis, NaN if unknown
+    /// volume axis (0 = x, 1 = y, 2 = z) stored at each file axis. NRRD does not name its axes, so the order can be
+    /// given as key/value pair "axis order:=zyx" (fastest axis first). Defaults to xyz.
+    int axis_order[3] = {0, 1, 2};
+
+    [[nodiscard]] size_t voxels() const { return sizes[0] * sizes[1] * sizes[2]; }
+    [[nodiscard]] size_t payload_bytes() const { return voxels() * label_bytes; }
+    [[nodiscard]] bool native_endian() const { return label_bytes == 1u || big_endian == (std::endian::native == std::endian::big); }
+    [[nodiscard]] bool xyz_order() const { return axis_order[0] == 0 && axis_order[1] == 1 && axis_order[2] == 2; }
+
+    /// @return the number of samples along the given volume axis
+    [[nodiscard]] size_t dimension(const int axis) const {
+        for (int i = 0; i < 3; i++) {
+            if (axis_order[i] == axis)
+                return sizes[i];
+        }
+        return 0u;
+    }
+
+    /// @return the spacing along the given volume axis, NaN if unknown
+    [[nodiscard]] double spacing(const int axis) const {
+        for (int i = 0; i < 3; i++) {
+            if (axis_order[i] == axis)
+                return spacings[i];
+        }
+        return NAN;
+    }
+
+    static NrrdHeader read(const std::filesystem::path &header_file) {
+        std::ifstream in(header_file, std::ios::binary);
+        if (!in.is_open())
+            throw std::runtime_error("could not open NRRD header " + header_file.string());
+
+        std::string line;
+        if (!std::getline(in, line) || !line.starts_with("NRRD000"))
+            throw std::runtime_error("missing NRRD magic in " + header_file.string());
+
+        NrrdHeader header;
+        bool has_sizes = false, has_type = false;
+        int dimension = 0;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            // an empty line ends the header, attached data starts right after it
+            if (line.empty())
+                break;
+            if (line.starts_with('#'))
+                continue;
+
+            // key/value pairs
+            if (const size_t kv = line.find(":="); kv != std::string::npos) {
+                if (line.substr(0, kv) == "axis order")
+                    header.axis_order_from_string(line.substr(kv + 2));
+                continue;
+            }
+
+            const size_t colon = line.find(": ");
+            if (colon == std::string::npos)
+                throw std::runtime_error("invalid NRRD header line '" + line + "'");
+            const std::string field = line.substr(0, colon);
+            const std::string value = line.substr(colon + 2);
+            std::istringstream values(value);
+
+            if (field == "type") {
+                header.label_bytes = label_bytes_from_type(value);
+                has_type = true;
+            } else if (field == "dimension") {
+                values >> dimension;
+            } else if (field == "sizes") {
+                values >> header.sizes[0] >> header.sizes[1] >> header.sizes[2];
+                has_sizes = static_cast<bool>(values);
+            } else if (field == "spacings") {
+                for (double &s : header.spacings) {
+                    std::string token;
+                    values >> token;
+                    s = (token.empty() || token == "nan" || token == "NaN") ? NAN : std::stod(token);
+                }
+            } else if (field == "space directions") {
+                // the spacing of each axis is the length of its direction vector
+                for (int i = 0; i < 3; i++) {
+                    double d[3] = {0., 0., 0.};
+                    char c;
+                    if (values >> c && c == '(' && values >> d[0] >> c >> d[1] >> c >> d[2] >> c)
+                        header.spacings[i] = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+                }
+            } else if (field == "encoding") {
+                if (value != "raw")
+                    throw std::runtime_error("unsupported NRRD encoding " + value + ", only raw is supported");
+            } else if (field == "endian") {
+                header.big_endian = value == "big";
+            } else if (field == "data file" || field == "datafile") {
+                if (value.starts_with("LIST") || value.find(' ') != std::string::npos)
+                    throw std::runtime_error("NRRD data files split into multiple files are not supported");
+                header.data_file = std::filesystem::path(value).is_absolute() ? std::filesystem::path(value)
+                                                                               : header_file.parent_path() / value;
+            } else if (field == "byte skip") {
+                long long skip = 0;
+                values >> skip;
+                header.byte_skip_from_end = skip < 0;
+                header.byte_skip = skip < 0 ? 0u : static_cast<size_t>(skip);
+            } else if (field == "line skip") {
+                long long skip = 0;
+                values >> skip;
+                if (skip != 0)
+                    throw std::runtime_error("NRRD line skip is not supported");
+            }
+        }
+
+        if (dimension != 3 || !has_sizes)
+            throw std::runtime_error("NRRD volume " + header_file.string() + " is not three dimensional");
+        if (!has_type)
+            throw std::runtime_error("NRRD header " + header_file.string() + " does not specify a type");
+        // attached data starts after the header
+        if (header.data_file.empty()) {
+            // without the blank separator line the header runs until the end of the file and there is no data offset
+            const std::streamoff data_offset = in.good() ? static_cast<std::streamoff>(in.tellg()) : -1;
+            if (data_offset < 0)
+                throw std::runtime_error("malformed NRRD header " + header_file.string()
+                                         + ": attached data must follow an empty line after the header");
+            header.data_file = header_file;
+            header.byte_skip += static_cast<size_t>(data_offset);
+        }
+        return header;
+    }
+
+  private:
+    static size_t label_bytes_from_type(const std::string &type) {
+        if (type == "uchar" || type == "unsigned char" || type == "uint8" || type == "uint8_t")
+            return 1u;
+        if (type == "ushort" || type == "unsigned short" || type == "unsigned short int" || type == "uint16"
+            || type == "uint16_t")
+            return 2u;
+        if (type == "uint" || type == "unsigned int" || type == "uint32" || type == "uint32_t")
+            return 4u;
+        if (type == "ulonglong" || type == "unsigned long long" || type == "unsigned long long int" || type == "uint64"
+            || type == "uint64_t")
+            return 8u;
+        throw std::runtime_error("unsupported NRRD label type " + type + ", labels must be unsigned integers");
+    }
+
+    void axis_order_from_string(const std::string &order) {
+        if (order.size() != 3u)
+            throw std::runtime_error("invalid NRRD axis order " + order);
+        bool seen[3] = {false, false, false};
+        for (int i = 0; i < 3; i++) {
+            const int axis = order[i] - 'x';
+            if (axis < 0 || axis > 2 || seen[axis])
+                throw std::runtime_error("invalid NRRD axis order " + order);
+            seen[axis] = true;
+            axis_order[i] = axis;
+        }
+    }
+};
+
+/// Segmentation volume imported from a raw NRRD file. If the data file is mapped, the mapping must outlive the image.
+struct RawVolume {
+    vtkSmartPointer<vtkImageData> image;
+    std::unique_ptr<MappedFile> mapping;    ///< mapped data file that stores the image scalars, nullptr if copied
+};
+
+/// Imports a label volume stored as raw NRRD file with a detached (.nhdr) or attached (.nrrd) header.
+/// If the labels are stored in xyz order, native byte order and at most 32 bit, the data file is mapped directly as
+/// image scalars without copying or decoding. Otherwise, the labels are converted into a new array in parallel.
+/// @param default_spacing voxel spacing used for all axes without a spacing in the header
+inline RawVolume read_nrrd(const std::filesystem::path &header_file, const double (&default_spacing)[3],
+                           const unsigned thread_count = 0u) {
+    const NrrdHeader header = NrrdHeader::read(header_file);
+
+    RawVolume volume;
+    volume.mapping = std::make_unique<MappedFile>(header.data_file);
+    const MappedFile &file = *volume.mapping;
+    const size_t offset = header.byte_skip_from_end ? file.size() - std::min(file.size(), header.payload_bytes())
+                                                    : header.byte_skip;
+    if (offset + header.payload_bytes() > file.size())
+        throw std::runtime_error("NRRD data file " + header.data_file.string() + " is smaller than the volume");
+    // labels are accessed front to back, both while computing statistics and while uploading them
+    file.advise(offset, header.payload_bytes(), MADV_SEQUENTIAL);
+    file.advise(offset, header.payload_bytes(), MADV_WILLNEED);
+
+    volume.image = vtkSmartPointer<vtkImageData>::New();
+    volume.image->SetDimensions(static_cast<int>(header.dimension(0)), static_cast<int>(header.dimension(1)),
+                                static_cast<int>(header.dimension(2)));
+    double spacing[3];
+    for (int a = 0; a < 3; a++)
+        spacing[a] = std::isnan(header.spacing(a)) ? default_spacing[a] : header.spacing(a);
+    volume.image->SetSpacing(spacing[0], spacing[1], spacing[2]);
+    volume.image->SetOrigin(0., 0., 0.);
+
+    const int label_type = labelTypeForBytes(header.label_bytes);
+    char *payload = file.data() + offset;
+    if (header.xyz_order() && header.native_endian() && header.label_bytes <= 4u
+        && reinterpret_cast<uintptr_t>(payload) % header.label_bytes == 0u) {
+        setExternalLabelScalars(volume.image, label_type, payload);
+        return volume;
+    }
+
+    // fallback: reorder, byte swap or narrow the labels into a separate array
+    volume.image->AllocateScalars(label_type, 1);
+    const size_t file_stride[3] = {1u, header.sizes[0], header.sizes[0] * header.sizes[1]};
+    size_t stride[3];   // file stride of each volume axis
+    for (int i = 0; i < 3; i++)
+        stride[header.axis_order[i]] = file_stride[i];
+    const size_t dim[3] = {header.dimension(0), header.dimension(1), header.dimension(2)};
+    const size_t bytes = header.label_bytes;
+    const bool swap = !header.native_endian();
+    visitLabelType(label_type, [&](auto label) {
+        using T = decltype(label);
+        T *dst = static_cast<T *>(volume.image->GetScalarPointer());
+        parallel_for(dim[1] * dim[2], thread_count, [&](const size_t yz, unsigned) {
+            const size_t y = yz % dim[1], z = yz / dim[1];
+            const char *src = payload + (y * stride[1] + z * stride[2]) * bytes;
+            T *row = dst + yz * dim[0];
+            for (size_t x = 0; x < dim[0]; x++) {
+                unsigned char b[8];
+                std::memcpy(b, src + x * stride[0] * bytes, bytes);
+                if (swap)
+                    std::reverse(b, b + bytes);
+                uint64_t l = 0u;
+                switch (bytes) {
+                case 1u: l = b[0]; break;
+                case 2u: { uint16_t v; std::memcpy(&v, b, 2u); l = v; break; }
+                case 4u: { uint32_t v; std::memcpy(&v, b, 4u); l = v; break; }
+                default: std::memcpy(&l, b, 8u); break;
+                }
+                if (l > std::numeric_limits<T>::max())
+                    throw std::runtime_error("label " + std::to_string(l) + " exceeds the supported label range");
+                row[x] = static_cast<T>(l);
+            }
+        });
+    });
+    // the labels were copied, the data file is not needed anymore
+    volume.mapping.reset();
+    return volume;
+}
+
+} // namespace vvv
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "Camera.hpp"
+#include "VoxelRegion.hpp"
 
 class SegmentedVolumeMaterial {
 
@@ -23,6 +24,9 @@ public:
     float opacity = 1.f;
     float emission = 0.f;
     int wrapping = 0; // wrap mode: 0 = clamp, 1 = repeat, 2 = random
+    std::vector<glm::vec3> colormap;      // RGB control points, evenly spaced over the normalized tfMinMax range
+    int colormapPrecomputed = -1;         // index of a Volcanite built-in color map, control points hold its samples
+    int colormapType = 0;
 };
 
 struct VolcaniteParameters {
@@ -31,9 +35,50 @@ struct VolcaniteParameters {
     glm::ivec3 axis_order = {0, 1, 2}; ///< permutation of 012 (xyz) axes
     glm::bvec3 axis_flip = {false, false, false};
     glm::vec3 axis_scale = {1.f, 1.f, 1.f};  ///< axis scaling normalized so that the largest axis scale is 1
-    glm::ivec2 split_plane_x;
-    glm::ivec2 split_plane_y;
-    glm::ivec2 split_plane_z;
+    glm::ivec2 split_plane_x = {0, INT32_MAX};
+    glm::ivec2 split_plane_y = {0, INT32_MAX};
+    glm::ivec2 split_plane_z = {0, INT32_MAX};
+
+    /// @return the voxel region within the split planes. Split planes are inclusive, i.e. voxel split_plane_x[1] is visible.
+    [[nodiscard]] vvv::VoxelRegion split_plane_region() const {
+        const glm::ivec2 planes[3] = {split_plane_x, split_plane_y, split_plane_z};
+        vvv::VoxelRegion region;
+        for (int a = 0; a < 3; a++) {
+            region.min[a] = static_cast<size_t>(glm::max(planes[a][0], 0));
+            region.max[a] = planes[a][1] == INT32_MAX ? SIZE_MAX : static_cast<size_t>(glm::max(planes[a][1] + 1, planes[a][0]));
+        }
+        return region;
+    }
+
+    /// @return the transformation from voxel coordinates into the clip space of the camera for a volume that is placed
+    /// as in the VTK scene: centered, with permuted and flipped axes, and camera distances scaled by the largest axis.
+    /// @param volume_bounds world space bounds of the complete volume with voxel (0,0,0) at the lower bound
+    [[nodiscard]] glm::mat4 voxel_to_clip_space(const double (&volume_bounds)[6], const float aspect_ratio) const {
+        return voxel_to_clip_space(volume_bounds, aspect_ratio, camera);
+    }
+
+    /// @return the transformation from voxel coordinates into the clip space of another view, e.g. a camera path frame,
+    /// with the projection of the .vcfg camera as it is used for rendering.
+    [[nodiscard]] glm::mat4 voxel_to_clip_space(const double (&volume_bounds)[6], const float aspect_ratio,
+                                                const vvv::Camera &view) const {
+        glm::vec3 lower, center;
+        float max_size = 0.f;
+        for (int a = 0; a < 3; a++) {
+            lower[a] = static_cast<float>(volume_bounds[2 * a]);
+            center[a] = static_cast<float>(0.5 * (volume_bounds[2 * a] + volume_bounds[2 * a + 1]));
+            max_size = glm::max(max_size, static_cast<float>(volume_bounds[2 * a + 1] - volume_bounds[2 * a]));
+        }
+        glm::mat4 axis_mat(0.f);
+        for (int a = 0; a < 3; a++)
+            axis_mat[a][axis_order[a]] = axis_flip[a] ? -1.f : 1.f;
+        axis_mat[3][3] = 1.f;
+
+        vvv::Camera view_camera = view;
+        view_camera.get_position();
+        return camera.get_view_to_projection_space(aspect_ratio) * view_camera.get_world_to_view_space()
+               * glm::scale(glm::vec3(1.f / glm::max(max_size, 1.f))) * axis_mat * glm::translate(-center)
+               * glm::translate(lower) * glm::scale(axis_scale);
+    }
 };
 
 class VcfgSegVolTFFileReader {
@@ -73,18 +118,16 @@ private:
                     std::cout << ".vcfg: invalid color map control point count " << colormap_control_points;
                     return false;
                 }
-                for (int i = 0; i < colormap_control_points; i++) {
-                    float tmp;
-                    parameter_stream >> tmp;
-                    parameter_stream >> tmp;
-                    parameter_stream >> tmp;
+                mat.colormap.resize(colormap_control_points);
+                for (auto& c : mat.colormap) {
+                    parameter_stream >> c.r;
+                    parameter_stream >> c.g;
+                    parameter_stream >> c.b;
                 }
-                int precomputedIdx;
-                parameter_stream >> precomputedIdx;
-                int type;
-                parameter_stream >> type;
-                if (type < 0 || type > 3) {
-                    std::cout << ".vcfg: unsupported color map type " << type;
+                parameter_stream >> mat.colormapPrecomputed;
+                parameter_stream >> mat.colormapType;
+                if (mat.colormapType < 0 || mat.colormapType > 3) {
+                    std::cout << ".vcfg: unsupported color map type " << mat.colormapType;
                     return false;
                 }
             }
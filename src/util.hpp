@@ -1,15 +1,30 @@
 #pragma once
 
+#include <vtkAOSDataArrayTemplate.h>
 #include <vtkCamera.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
 #include <vtkSmartPointer.h>
+#include <vtkType.h>
 #include <vtkVersion.h>
 #include <vtkWindowToImageFilter.h>
 
 #include "stb/stb_image_write.hpp"
 
 #include <cstdint>
+#include <cstdio>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "intervals.hpp"
+#include "parallel.hpp"
+#include "VoxelRegion.hpp"
 
 
 inline void exportCamera(vtkCamera* camera, const std::filesystem::path& filename) {
@@ -77,24 +92,78 @@ inline void importCamera(vtkCamera* camera, const std::filesystem::path& filenam
     file.close();
 }
 
-inline void exportImage(const vtkSmartPointer<vtkRenderWindow>& renderWindow, const std::filesystem::path& file)
+/// View of a camera as stored by exportCamera.
+struct CameraView
 {
-    // Capture the rendered image from the render window
-    vtkSmartPointer<vtkWindowToImageFilter> windowToImageFilter = vtkSmartPointer<vtkWindowToImageFilter>::New();
-    windowToImageFilter->SetInput(renderWindow);
-    windowToImageFilter->SetInputBufferTypeToRGBA(); // Capture RGBA
-    windowToImageFilter->ReadFrontBufferOff(); // Read from back buffer
-    windowToImageFilter->Update();
+    double position[3] = {0., 0., 1.};
+    double focal_point[3] = {0., 0., 0.};
+    double view_up[3] = {0., 1., 0.};
+};
 
-    vtkImageData* imageData = windowToImageFilter->GetOutput();
+inline CameraView getCameraView(vtkCamera* camera)
+{
+    CameraView view;
+    camera->GetPosition(view.position);
+    camera->GetFocalPoint(view.focal_point);
+    camera->GetViewUp(view.view_up);
+    return view;
+}
 
-    int* dims = imageData->GetDimensions();
-    int width = dims[0];
-    int height = dims[1];
-    int numberOfComponents = imageData->GetNumberOfScalarComponents();
+inline void setCameraView(vtkCamera* camera, const CameraView& view)
+{
+    camera->SetPosition(view.position);
+    camera->SetFocalPoint(view.focal_point);
+    camera->SetViewUp(view.view_up);
+}
 
-    unsigned char* vtkPixels = static_cast<unsigned char*>(imageData->GetScalarPointer());
+/// Reads a list of camera views from a file of concatenated exportCamera entries. Each entry starts with its Position
+/// line, missing FocalPoint or ViewUp lines keep the values of the previous entry. Projection parameters are ignored.
+inline std::vector<CameraView> importCameraViews(const std::filesystem::path& filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("Could not open camera list " + filename.string());
+
+    std::vector<CameraView> views;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.find("Position") == 0) {
+            views.push_back(views.empty() ? CameraView{} : views.back());
+            sscanf(line.c_str(), "Position %lf %lf %lf", &views.back().position[0], &views.back().position[1], &views.back().position[2]);
+        }
+        else if (views.empty()) {
+            continue;
+        }
+        else if (line.find("FocalPoint") == 0) {
+            sscanf(line.c_str(), "FocalPoint %lf %lf %lf", &views.back().focal_point[0], &views.back().focal_point[1], &views.back().focal_point[2]);
+        }
+        else if (line.find("ViewUp") == 0) {
+            sscanf(line.c_str(), "ViewUp %lf %lf %lf", &views.back().view_up[0], &views.back().view_up[1], &views.back().view_up[2]);
+        }
+    }
+    return views;
+}
 
+/// Generates count views on an orbit of the camera around its focal point. The camera position is rotated about the
+/// view up vector in equal steps, starting with the current view.
+inline std::vector<CameraView> orbitCameraViews(vtkCamera* camera, const int count)
+{
+    const vtkSmartPointer<vtkCamera> orbit = vtkSmartPointer<vtkCamera>::New();
+    orbit->DeepCopy(camera);
+    std::vector<CameraView> views;
+    for (int i = 0; i < count; i++) {
+        views.push_back(getCameraView(orbit));
+        orbit->Azimuth(360. / count);
+        orbit->OrthogonalizeViewUp();
+    }
+    return views;
+}
+
+/// Writes 8 bit pixels with rows from bottom to top (as in VTK and OpenGL) to a .png or .jpg file.
+/// @return false if the file could not be written
+inline bool exportPixels(const unsigned char* pixels, const int width, const int height, const int numberOfComponents,
+                         const std::filesystem::path& file)
+{
     // stbi_write_* expects row pointers from top-left, whereas VTK image origin is bottom-left
     // So we need to flip vertically before saving
     std::vector<unsigned char> flippedPixels(width * height * numberOfComponents);
@@ -102,7 +171,7 @@ inline void exportImage(const vtkSmartPointer<vtkRenderWindow>& renderWindow, co
     {
         memcpy(
             &flippedPixels[y * width * numberOfComponents],
-            &vtkPixels[(height - y - 1) * width * numberOfComponents],
+            &pixels[(height - y - 1) * width * numberOfComponents],
             width * numberOfComponents);
     }
 
@@ -115,7 +184,7 @@ inline void exportImage(const vtkSmartPointer<vtkRenderWindow>& renderWindow, co
                            width * numberOfComponents))
         {
             std::cerr << "Failed to save JPEG file " << file << std::endl;
-            return;
+            return false;
         }
     } else if (file.extension() == ".png")
     {
@@ -124,53 +193,197 @@ inline void exportImage(const vtkSmartPointer<vtkRenderWindow>& renderWindow, co
                            width * numberOfComponents))
         {
             std::cerr << "Failed to save PNG file " << file <<  std::endl;
-            return;
+            return false;
         }
     }
     else
     {
         std::cerr << "Image file extension not recognized: " << file << std::endl;
-        return;
+        return false;
     }
 
     std::cout << "Saved image to " << file << std::endl;
+    return true;
 }
 
-struct Interval {
-    uint32_t start;
-    uint32_t end;
-};
+/// Writes the back buffer of the render window to a .png or .jpg file.
+/// @return false if the file could not be written
+inline bool exportImage(const vtkSmartPointer<vtkRenderWindow>& renderWindow, const std::filesystem::path& file)
+{
+    // Capture the rendered image from the render window
+    vtkSmartPointer<vtkWindowToImageFilter> windowToImageFilter = vtkSmartPointer<vtkWindowToImageFilter>::New();
+    windowToImageFilter->SetInput(renderWindow);
+    windowToImageFilter->SetInputBufferTypeToRGBA(); // Capture RGBA
+    windowToImageFilter->ReadFrontBufferOff(); // Read from back buffer
+    windowToImageFilter->Update();
 
-inline std::vector<Interval> mergeIntervals(std::vector<Interval> &intervals) {
-    if (intervals.empty()) {
-        return {};
-    }
+    vtkImageData* imageData = windowToImageFilter->GetOutput();
 
-    // Sort intervals by their start value
-    std::sort(intervals.begin(), intervals.end(), [](const Interval a, const Interval b) {
-        return a.start < b.start;
-    });
+    int* dims = imageData->GetDimensions();
+    int width = dims[0];
+    int height = dims[1];
+    int numberOfComponents = imageData->GetNumberOfScalarComponents();
 
-    std::vector<Interval> merged;
+    unsigned char* vtkPixels = static_cast<unsigned char*>(imageData->GetScalarPointer());
+    return exportPixels(vtkPixels, width, height, numberOfComponents, file);
+}
 
-    // Push first interval to merged
-    merged.push_back(intervals[0]);
+/// @return the unsigned VTK scalar type for labels stored with the given byte size. 64 bit labels are narrowed to 32 bit.
+inline int labelTypeForBytes(const size_t bytes)
+{
+    if (bytes <= 1)
+        return VTK_UNSIGNED_CHAR;
+    if (bytes <= 2)
+        return VTK_UNSIGNED_SHORT;
+    return VTK_UNSIGNED_INT;
+}
 
-    for (size_t i = 1; i < intervals.size(); ++i) {
-        // Reference to last merged interval
+/// @return the smallest unsigned VTK scalar type that can store all labels in [0, label_max]
+inline int smallestLabelType(const uint32_t label_max)
+{
+    if (label_max <= UINT8_MAX)
+        return VTK_UNSIGNED_CHAR;
+    if (label_max <= UINT16_MAX)
+        return VTK_UNSIGNED_SHORT;
+    return VTK_UNSIGNED_INT;
+}
 
-        if (auto [start, end] = merged.back(); end >= intervals[i].start) {
-            // If overlapping, merge by extending the end if needed
-            if (end < intervals[i].end) {
-                end = intervals[i].end;
+/// Calls func(T{}) with T being the C++ type of the given integer VTK scalar type.
+template <typename F>
+void visitLabelType(const int vtk_type, F&& func)
+{
+    switch (vtk_type)
+    {
+    case VTK_UNSIGNED_CHAR: func(uint8_t{}); break;
+    case VTK_UNSIGNED_SHORT: func(uint16_t{}); break;
+    case VTK_UNSIGNED_INT: func(uint32_t{}); break;
+    case VTK_CHAR:
+    case VTK_SIGNED_CHAR: func(int8_t{}); break;
+    case VTK_SHORT: func(int16_t{}); break;
+    case VTK_INT: func(int32_t{}); break;
+    default:
+        throw std::runtime_error("unsupported label scalar type " + std::to_string(vtk_type));
+    }
+}
+
+/// Replaces the scalars of image by the smallest unsigned type that can store all labels in [0, label_max].
+/// @return true if the scalars were narrowed, false if they are already stored in the smallest type
+inline bool narrowLabelScalars(vtkImageData* image, const uint32_t label_max, const unsigned thread_count = 0u)
+{
+    const int src_type = image->GetScalarType();
+    const int dst_type = smallestLabelType(label_max);
+    if (vtkDataArray::GetDataTypeSize(dst_type) >= vtkDataArray::GetDataTypeSize(src_type))
+        return false;
+
+    const auto voxels = static_cast<size_t>(image->GetNumberOfPoints());
+    const vtkSmartPointer<vtkDataArray> narrowed = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(dst_type));
+    narrowed->SetNumberOfComponents(1);
+    narrowed->SetNumberOfTuples(static_cast<vtkIdType>(voxels));
+    narrowed->SetName(image->GetPointData()->GetScalars()->GetName());
+    visitLabelType(src_type, [&](auto src_label) {
+        visitLabelType(dst_type, [&](auto dst_label) {
+            const auto* src = static_cast<const decltype(src_label)*>(image->GetScalarPointer());
+            auto* dst = static_cast<decltype(dst_label)*>(narrowed->GetVoidPointer(0));
+            vvv::parallel_for_blocks(voxels, 1u << 20, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+                for (size_t i = begin; i < end; i++)
+                    dst[i] = static_cast<decltype(dst_label)>(src[i]);
+            });
+        });
+    });
+    image->GetPointData()->SetScalars(narrowed);
+    return true;
+}
+
+/// Replaces the labels of image by 8 bit classes, e.g. material indices, evaluated in parallel. Neighboring voxels
+/// mostly share their label, so class_of is only evaluated when the label changes.
+/// @param class_of thread safe callable with signature uint8_t(uint32_t label)
+template <typename F>
+void classifyLabelScalars(vtkImageData* image, F&& class_of, const unsigned thread_count = 0u)
+{
+    const auto voxels = static_cast<size_t>(image->GetNumberOfPoints());
+    const vtkSmartPointer<vtkDataArray> classes = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(VTK_UNSIGNED_CHAR));
+    classes->SetNumberOfComponents(1);
+    classes->SetNumberOfTuples(static_cast<vtkIdType>(voxels));
+    classes->SetName(image->GetPointData()->GetScalars()->GetName());
+    visitLabelType(image->GetScalarType(), [&](auto label) {
+        const auto* src = static_cast<const decltype(label)*>(image->GetScalarPointer());
+        auto* dst = static_cast<uint8_t*>(classes->GetVoidPointer(0));
+        vvv::parallel_for_blocks(voxels, 1u << 20, thread_count, [&](const size_t begin, const size_t end, unsigned) {
+            auto prev = src[begin];
+            uint8_t c = class_of(static_cast<uint32_t>(prev));
+            for (size_t i = begin; i < end; i++) {
+                if (src[i] != prev) {
+                    prev = src[i];
+                    c = class_of(static_cast<uint32_t>(prev));
+                }
+                dst[i] = c;
             }
-        } else {
-            // No overlap, add interval to merged
-            merged.push_back(intervals[i]);
-        }
+        });
+    });
+    image->GetPointData()->SetScalars(classes);
+}
+
+/// Sets externally owned labels of the given VTK type as scalars of image without copying them.
+/// The image dimensions must be set before and the labels must outlive the image scalars.
+inline void setExternalLabelScalars(vtkImageData* image, const int vtk_type, void* labels)
+{
+    visitLabelType(vtk_type, [&](auto label) {
+        using T = decltype(label);
+        auto scalars = vtkSmartPointer<vtkAOSDataArrayTemplate<T>>::New();
+        scalars->SetNumberOfComponents(1);
+        // save = 1: VTK must not free the external memory
+        scalars->SetArray(static_cast<T*>(labels), static_cast<vtkIdType>(image->GetNumberOfPoints()), 1);
+        scalars->SetName("labels");
+        image->GetPointData()->SetScalars(scalars);
+    });
+}
+
+/// @return the voxel region that the image covers within the complete volume whose lower bound is voxel (0,0,0)
+/// @param volume_bounds world space bounds of the complete volume
+inline vvv::VoxelRegion imageVoxelRegion(vtkImageData* image, const double (&volume_bounds)[6])
+{
+    int dim[3];
+    double origin[3], spacing[3];
+    image->GetDimensions(dim);
+    image->GetOrigin(origin);
+    image->GetSpacing(spacing);
+    vvv::VoxelRegion region;
+    for (int a = 0; a < 3; a++) {
+        region.min[a] = static_cast<size_t>(std::max(0l, std::lround((origin[a] - volume_bounds[2 * a]) / spacing[a])));
+        region.max[a] = region.min[a] + static_cast<size_t>(dim[a]);
     }
+    return region;
+}
 
-    return merged;
+/// @return a copy of the given region of the image (in image voxel coordinates) that keeps its world space placement
+inline vtkSmartPointer<vtkImageData> cropLabelImage(vtkImageData* image, const vvv::VoxelRegion& region,
+                                                    const unsigned thread_count = 0u)
+{
+    int dim[3];
+    double origin[3], spacing[3];
+    image->GetDimensions(dim);
+    image->GetOrigin(origin);
+    image->GetSpacing(spacing);
+
+    auto cropped = vtkSmartPointer<vtkImageData>::New();
+    cropped->SetDimensions(static_cast<int>(region.extent(0)), static_cast<int>(region.extent(1)),
+                           static_cast<int>(region.extent(2)));
+    cropped->SetSpacing(spacing);
+    cropped->SetOrigin(origin[0] + static_cast<double>(region.min[0]) * spacing[0],
+                       origin[1] + static_cast<double>(region.min[1]) * spacing[1],
+                       origin[2] + static_cast<double>(region.min[2]) * spacing[2]);
+    cropped->AllocateScalars(image->GetScalarType(), 1);
+    visitLabelType(image->GetScalarType(), [&](auto label) {
+        using T = decltype(label);
+        const T* src = static_cast<const T*>(image->GetScalarPointer());
+        T* dst = static_cast<T*>(cropped->GetScalarPointer());
+        const size_t rows_y = region.extent(1);
+        vvv::parallel_for(rows_y * region.extent(2), thread_count, [&](const size_t row, unsigned) {
+            const size_t y = region.min[1] + row % rows_y, z = region.min[2] + row / rows_y;
+            std::copy_n(src + (z * dim[1] + y) * dim[0] + region.min[0], region.extent(0), dst + row * region.extent(0));
+        });
+    });
+    return cropped;
 }
 
 inline void printCameraInfo(vtkCamera* camera)
@@ -193,8 +406,33 @@ struct EvalResult
     double frame[16] = {0.};
     double time_io_s = 0.f;
     double time_to_first_frame = 0.f;
+    unsigned io_threads = 1;      ///< threads used for reading the volume
+    double io_gb_per_s = 0.f;     ///< achieved volume read throughput
+    bool io_cached = false;       ///< volume was mapped from the volume cache or a shared volume instead of being read
+    std::string renderer;         ///< name of the volume rendering backend
 };
 
+/// @return the .csv file to append rows with the given header to: the file itself if it does not exist yet or starts
+///         with the same header, otherwise the first file <stem>-<n><extension> that does. Rows are never appended
+///         below the header of an older column layout.
+inline std::filesystem::path csvLogFile(const std::filesystem::path& file, const std::string& header)
+{
+    std::filesystem::path path = file;
+    for (int n = 1; std::filesystem::exists(path); n++)
+    {
+        std::ifstream in(path);
+        std::string firstLine;
+        std::getline(in, firstLine);
+        if (firstLine == header)
+            break;
+        path = file;
+        path.replace_filename(file.stem().string() + "-" + std::to_string(n) + file.extension().string());
+    }
+    if (path != file)
+        std::cerr << "Columns of " << file << " differ from the current results, writing to " << path << std::endl;
+    return path;
+}
+
 inline void exportResults(const std::string& name, const EvalResult &result, const std::filesystem::path& file, bool consoleLog = true)
 {
     if (consoleLog)
@@ -210,16 +448,26 @@ inline void exportResults(const std::string& name, const EvalResult &result, con
         std::cout << "  max: " << result.max << std::endl;
         std::cout << "  time preprocess/IO:  " << result.time_io_s << std::endl;
         std::cout << "  time to first frame: " << result.time_to_first_frame << std::endl;
+        std::cout << "  IO throughput:       " << result.io_gb_per_s << " GB/s with " << result.io_threads << " thread(s)" << std::endl;
+        std::cout << "  IO from cache:       " << (result.io_cached ? "yes" : "no") << std::endl;
+        std::cout << "  renderer:            " << result.renderer << std::endl;
     }
 
-    const bool newFile = !std::filesystem::exists(file);
+    std::ostringstream header;
+    header << "Data Set,frame min [ms],frame avg [ms],frame max [ms],stdv,frame med [ms]";
+    for (int i = 0; i < sizeof(EvalResult::frame)/sizeof(double); i++)
+        header << ",frame" << i;
+    header << ",preprocess IO time [s],time to first frame [s],IO threads,IO throughput [GB/s],IO cached,renderer,time";
+
+    const std::filesystem::path logPath = csvLogFile(file, header.str());
+    const bool newFile = !std::filesystem::exists(logPath);
     if (newFile)
-        std::filesystem::create_directories(file.parent_path());
+        std::filesystem::create_directories(logPath.parent_path());
 
-    std::ofstream logFile(file, std::ios::out | std::ios::app);
+    std::ofstream logFile(logPath, std::ios::out | std::ios::app);
     if (!logFile.is_open())
     {
-        std::cerr << "Failed to open log file " << file << std::endl;
+        std::cerr << "Failed to open log file " << logPath << std::endl;
         return;
     }
 
@@ -231,12 +479,7 @@ inline void exportResults(const std::string& name, const EvalResult &result, con
 
     // if file did not exist: write CSV header
     if (newFile)
-    {
-        logFile << "Data Set,frame min [ms],frame avg [ms],frame max [ms],stdv,frame med [ms]";
-        for (int i = 0; i < sizeof(EvalResult::frame)/sizeof(double); i++)
-            logFile << ",frame" << i;
-        logFile << ",preprocess IO time [s],time to first frame [s],time" << std::endl;
-    }
+        logFile << header.str() << std::endl;
 
     logFile << "# " << time_buf << ", VTK Version " << vtkVersion::GetVTKVersion() << std::endl;
 
@@ -246,12 +489,35 @@ inline void exportResults(const std::string& name, const EvalResult &result, con
     for (const double f : result.frame)
         logFile << "," << f;
     logFile << "," << result.time_io_s << "," << result.time_to_first_frame;
+    logFile << "," << result.io_threads << "," << result.io_gb_per_s << "," << result.io_cached;
+    logFile << "," << result.renderer;
     logFile << "," << time_buf;
     logFile << std::endl;
 
     logFile.close();
 }
 
+/// Appends the time of each frame in render order to a .csv file, one line per frame.
+inline void exportFrameTimes(const std::string& name, const std::vector<double>& frame_times_ms, const std::filesystem::path& file)
+{
+    const std::string header = "Data Set,frame,frame time [ms]";
+    const std::filesystem::path logPath = csvLogFile(file, header);
+    const bool newFile = !std::filesystem::exists(logPath);
+    if (newFile)
+        std::filesystem::create_directories(logPath.parent_path());
+
+    std::ofstream logFile(logPath, std::ios::out | std::ios::app);
+    if (!logFile.is_open())
+    {
+        std::cerr << "Failed to open log file " << logPath << std::endl;
+        return;
+    }
+    if (newFile)
+        logFile << header << std::endl;
+    for (size_t i = 0; i < frame_times_ms.size(); i++)
+        logFile << name << "," << i << "," << frame_times_ms[i] << std::endl;
+}
+
 // from PCG Hash from "Hash Functions for GPU Rendering", Mark Jarzynski and Marc Olano
 unsigned int pcg_hash(uint v)
 {